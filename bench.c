@@ -0,0 +1,207 @@
+/* bench.c */
+
+/*
+Microbenchmarks for the hot kernels of gsinks.c: tarjan, reachscc,
+colourdigraph, ismax, filter_and_output and the digraph6 encoding (ntod6)
+and decoding (stringtograph) that input and output go through.
+
+Built and run by "make bench". This file includes gsinks.c with its main()
+left out, so the kernels are compiled exactly as in gsinks.
+
+The inputs are fixed: for each n = 4, 8, ..., 32, NGRAPHS digraphs of each
+family (random with arc probability 1/3, sparse random with arc probability
+1/16, which leaves many twins, edgeless, random tournaments, and directed
+cycles with their vertices shuffled), made from a fixed seed by gendig.c's
+generator. The
+calls cycle through the NGRAPHS digraphs, so that no single input is learned
+by the branch predictor. Each kernel is warmed up and calibrated, then timed
+REPEATS times for at least MINRUN ns each, and the median ns per call is
+reported. colourdigraph can visit 2^n colourings, so it is only run up to
+COLOURMAXN.
+
+Usage: gsinksbench [KERNEL]   (only the kernels whose name contains KERNEL)
+*/
+
+#define NOMAIN
+#include "gsinks.c"
+#include "gendig.c"
+
+#define NGRAPHS 64
+#define REPEATS 5
+#define MINRUN 10000000LL       // ns
+#ifndef COLOURMAXN
+#define COLOURMAXN 16
+#endif
+
+enum {F_RANDOM, F_SPARSE, F_EDGELESS, F_TOURNAMENT, F_CYCLE, NFAMILIES};
+static const char *familyname[NFAMILIES] =
+    {"random", "sparse", "edgeless", "tournament", "cycle"};
+
+static graph bg[NGRAPHS][MAXN*MAXM];        // the inputs
+static struct sccstate bsccs[NGRAPHS];      // their SCCs
+static char *bd6[NGRAPHS];                  // and their digraph6 lines
+static int bperm[NGRAPHS][MAXN];            // random permutations, for ismax
+static int bcol[NGRAPHS][MAXN];             // random colourings
+static graph scratch[MAXN*MAXM];
+static volatile long long benchsink;        // keeps results from being optimised away
+
+static void
+makegraphs(int family, int m, int n)
+/* Make the NGRAPHS inputs of the family with gendig's makedigraph, with
+   everything derived from them. */
+{
+    int k,i;
+
+    for (k = 0; k < NGRAPHS; ++k)
+    {
+        switch (family)
+        {
+            case F_RANDOM:     makedigraph(1.0/3,0,0,0,FALSE,FALSE,m,n); break;
+            case F_SPARSE:     makedigraph(1.0/16,0,0,0,FALSE,FALSE,m,n); break;
+            case F_EDGELESS:   makedigraph(0.0,0,0,0,FALSE,FALSE,m,n); break;
+            case F_TOURNAMENT: makedigraph(0.0,0,0,0,TRUE,FALSE,m,n); break;
+            case F_CYCLE:      makedigraph(0.0,0,0,n,FALSE,FALSE,m,n); break;
+        }
+        memcpy(bg[k],g,m * (size_t)n * sizeof(graph));
+        tarjan(&bsccs[k],bg[k],m,n);
+        free(bd6[k]);
+        bd6[k] = strdup(ntod6(bg[k],m,n));
+        shuffle(bperm[k],n);
+        for (i = 0; i < n; ++i) bcol[k][i] = rng() & 1;
+    }
+}
+
+/**************************************************************************/
+
+typedef void benchproc(int k, int m, int n);
+
+static void
+b_tarjan(int k, int m, int n)
+{
+    tarjan(&sinkscc,bg[k],m,n);
+    benchsink += sinkscc.currentSCC;
+}
+
+static void
+b_reachscc(int k, int m, int n)
+{
+    reachscc(&sinkscc,bg[k],n);
+    benchsink += sinkscc.currentSCC;
+}
+
+static void
+b_colourdigraph(int k, int m, int n)
+{
+    sccs = &bsccs[k];
+    colourdigraph(bg[k],0,0,NOLIMIT,2,m,n);
+}
+
+static void
+b_ismax(int k, int m, int n)
+{
+    benchsink += ismax(bperm[k],n);
+}
+
+static void
+b_filter(int k, int m, int n)
+{
+    sccs = &bsccs[k];
+    filter_and_output(bg[k],bcol[k],m,n,0);
+}
+
+static void
+b_encode(int k, int m, int n)
+{
+    benchsink += ntod6(bg[k],m,n)[2];
+}
+
+static void
+b_decode(int k, int m, int n)
+{
+    stringtograph(bd6[k],scratch,m);
+    benchsink += scratch[0];
+}
+
+static struct {const char *name; benchproc *proc; int maxn; boolean oneword;}
+kernels[] = {
+    {"tarjan",            b_tarjan,        MAXN,       FALSE},
+    {"reachscc",          b_reachscc,      MAXN,       TRUE},
+    {"colourdigraph",     b_colourdigraph, COLOURMAXN, FALSE},
+    {"ismax",             b_ismax,         MAXN,       FALSE},
+    {"filter_and_output", b_filter,        MAXN,       FALSE},
+    {"d6encode",          b_encode,        MAXN,       FALSE},
+    {"d6decode",          b_decode,        MAXN,       FALSE},
+};
+#define NKERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+static int
+comparedouble(const void *a, const void *b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+
+    return (x > y) - (x < y);
+}
+
+static double
+timekernel(benchproc *proc, int m, int n)
+/* The median over REPEATS runs of the ns per call of proc. */
+{
+    double per[REPEATS];
+    long long calls,i,t0,elapsed;
+    int r;
+
+    // warm up, doubling the calls until they take a tenth of MINRUN
+    for (calls = NGRAPHS; ; calls *= 2)
+    {
+        t0 = nanotime();
+        for (i = 0; i < calls; ++i) (*proc)(i % NGRAPHS,m,n);
+        elapsed = nanotime() - t0;
+        if (elapsed >= MINRUN/10) break;
+    }
+    calls = calls * (MINRUN / elapsed + 1);
+
+    for (r = 0; r < REPEATS; ++r)
+    {
+        t0 = nanotime();
+        for (i = 0; i < calls; ++i) (*proc)(i % NGRAPHS,m,n);
+        per[r] = (double)(nanotime() - t0) / calls;
+    }
+    qsort(per,REPEATS,sizeof(double),comparedouble);
+    return per[REPEATS/2];
+}
+
+int
+main(int argc, char *argv[])
+{
+    int n,m,family,i;
+    unsigned int kern;
+    static const int sizes[] = {4, 8, 12, 16, 20, 24, 28, 32};
+
+    nauty_check(WORDSIZE,1,1,NAUTYVERSIONID);
+    // count only: filter_and_output and colourdigraph write nothing
+    dswitch = FALSE;
+    mine = 0;
+    maxe = NOLIMIT;
+
+    printf("%-18s %-11s %3s %12s\n","kernel","family","n","ns/op");
+    for (kern = 0; kern < NKERNELS; ++kern)
+    {
+        if (argc > 1 && !strstr(kernels[kern].name,argv[1])) continue;
+        for (family = 0; family < NFAMILIES; ++family)
+            for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); ++i)
+            {
+                n = sizes[i];
+                m = SETWORDSNEEDED(n);
+                if (n > kernels[kern].maxn || (kernels[kern].oneword && m > 1))
+                    continue;
+                seedrng(n);
+                makegraphs(family,m,n);
+                selectkernels(n);
+                memcpy(col,bcol[0],n * sizeof(int));   // for ismax
+                printf("%-18s %-11s %3d %12.1f\n",kernels[kern].name,
+                       familyname[family],n,timekernel(kernels[kern].proc,m,n));
+                fflush(stdout);
+            }
+    }
+    exit(0);
+}
@@ -0,0 +1,114 @@
+#!/bin/bash
+# The end-to-end check behind "make check-perf".
+# Runs gsinks on each input listed in knowncounts.txt (dig1..dig5 and
+# digl1..digl5, so N = 2..6), and fails if a total differs from the table.
+# Each input is run REPEATS times and the fastest run is kept. The wall time,
+# input graphs/s and peak RSS of each input, and the totals, go to RESULTS
+# as JSON. If BASELINE exists (a RESULTS file saved by "make perf-baseline"),
+# it also fails when the total graphs/s has dropped by more than TOLERANCE
+# percent from it.
+#
+# usage: checkperf.sh GSINKS DATADIR RESULTS BASELINE TOLERANCE
+# The data files come from getdata.sh, into DATADIR.
+
+GSINKS=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+DATADIR=$2
+RESULTS=$3
+BASELINE=$4
+TOLERANCE=$5
+KNOWN=$(cd "$(dirname "$0")" && pwd)/knowncounts.txt
+REPEATS=3
+METRICS=$(mktemp)
+trap 'rm -f "$METRICS"' EXIT
+
+case "$RESULTS" in /*) ;; *) RESULTS=$PWD/$RESULTS ;; esac
+case "$BASELINE" in /*|"") ;; *) BASELINE=$PWD/$BASELINE ;; esac
+cd "$DATADIR" || exit 1
+
+metric()
+# The value of metric $1 in the metrics file.
+{
+    awk -v name="$1" '$1 == name {print $2}' "$METRICS"
+}
+
+fail=0
+runs=""
+totalgraphs=0
+totalsecs=0
+while read -r input n expected
+do
+    case "$input" in ''|'#'*) continue ;; esac
+    if [ ! -r "$input.d6" ]
+    then
+        echo ">E check-perf: $DATADIR/$input.d6 is missing (see getdata.sh)"
+        exit 1
+    fi
+    case "$input" in digl*) loops=-l ;; *) loops= ;; esac
+
+    best=
+    for ((r = 0; r < REPEATS; ++r))
+    do
+        start=$(date +%s%N)
+        total=$("$GSINKS" $loops --metrics-file "$METRICS" "$n" 2>&1 >/dev/null | tail -1)
+        end=$(date +%s%N)
+        if [ "$total" != "$expected" ]
+        then
+            echo ">E check-perf: $input (N=$n) gave '$total', expected $expected"
+            fail=1
+            break
+        fi
+        ns=$((end - start))
+        if [ -z "$best" ] || [ "$ns" -lt "$best" ]; then best=$ns; fi
+    done
+    [ "$total" = "$expected" ] || continue
+
+    graphs=$(metric gsinks_input_graphs_total)
+    rss=$(metric gsinks_peak_resident_memory_bytes)
+    secs=$(awk -v ns="$best" 'BEGIN {printf "%.6f", ns / 1e9}')
+    rate=$(awk -v g="$graphs" -v s="$secs" 'BEGIN {printf "%.1f", g / s}')
+    printf "%-6s N=%d  total %-8s %8d graphs  %9.6f s  %11.1f graphs/s  peak RSS %d\n" \
+        "$input" "$n" "$total" "$graphs" "$secs" "$rate" "$rss"
+    runs="$runs${runs:+,
+}    {\"input\": \"$input\", \"n\": $n, \"total\": $total, \"graphs\": $graphs, \"seconds\": $secs, \"graphs_per_second\": $rate, \"peak_rss_bytes\": $rss}"
+    totalgraphs=$((totalgraphs + graphs))
+    totalsecs=$(awk -v a="$totalsecs" -v b="$secs" 'BEGIN {printf "%.6f", a + b}')
+done < "$KNOWN"
+
+totalrate=$(awk -v g="$totalgraphs" -v s="$totalsecs" 'BEGIN {printf "%.1f", (s > 0 ? g / s : 0)}')
+cat > "$RESULTS" <<JSON
+{
+  "gsinks": "$1",
+  "date": "$(date -u +%Y-%m-%dT%H:%M:%SZ)",
+  "runs": [
+$runs
+  ],
+  "total": {"graphs": $totalgraphs, "seconds": $totalsecs, "graphs_per_second": $totalrate}
+}
+JSON
+echo "total  $totalgraphs graphs  $totalsecs s  $totalrate graphs/s  (written to $RESULTS)"
+
+if [ $fail != 0 ]
+then
+    echo ">E check-perf: wrong totals"
+    exit 1
+fi
+
+if [ -z "$BASELINE" ] || [ ! -r "$BASELINE" ]
+then
+    echo "no baseline to compare with; make perf-baseline saves one"
+    exit 0
+fi
+baserate=$(sed -n 's/^ *"total": {.*"graphs_per_second": *\([0-9.]*\).*/\1/p' "$BASELINE")
+if [ -z "$baserate" ]
+then
+    echo ">E check-perf: no total graphs_per_second in $BASELINE"
+    exit 1
+fi
+awk -v now="$totalrate" -v base="$baserate" -v tol="$TOLERANCE" 'BEGIN {
+    change = 100 * (now - base) / base
+    printf "throughput %.1f graphs/s against a baseline of %.1f: %+.1f%%\n", now, base, change
+    if (change < -tol) {
+        printf ">E check-perf: throughput dropped by more than %s%%\n", tol
+        exit 1
+    }
+}'
@@ -0,0 +1,303 @@
+/* gendig.c */
+
+/*
+Writes random or structured digraphs in digraph6, as input for gsinks at
+sizes beyond McKay's files (which stop at 6 vertices).
+
+The families:
+  random       each arc present with probability p (-p), so -p0 is edgeless
+  -c#          a given number of SCCs, the last -L# of them leaves (SCCs with
+               no arcs out). Each SCC is a cycle through its vertices plus
+               random arcs inside it, and each SCC that is not a leaf has arcs
+               to later SCCs only, at least one.
+  -y#          disjoint directed cycles of the given length, with the vertices
+               left over isolated: digraphs with large groups
+  -t           tournaments
+In all of them the vertices are relabelled at random at the end, so that
+the structure doesn't show in the labels.
+
+The digraphs come from a fixed seed (-S), so a run can be repeated exactly.
+bench.c includes this file with NOMAIN defined, and makes its inputs with
+makedigraph, so that its families are the same as these.
+
+Building instructions
+SEE readme.MD
+*/
+
+#ifndef NOMAIN
+#define USAGE \
+  "gendig [-p#] [-c# [-L#] | -y# | -t] [-l] [-S#] n [count]"
+
+#define HELPTEXT \
+" gendig : write random or structured digraphs in digraph6\n\
+\n\
+     -p#    arc probability, as a fraction (default 0.3); -p0 gives\n\
+            edgeless digraphs\n\
+     -c#    exactly # strongly connected components (SCCs)\n\
+     -L#    # of the SCCs are leaves, with no arcs out (default 1, with -c)\n\
+     -y#    disjoint directed cycles of length #, the rest of the vertices\n\
+            isolated; these have large groups (-p only gives the loops)\n\
+     -t     tournaments\n\
+     -l     self-loops allowed, each with the arc probability\n\
+     -S#    random seed (default 1)\n\
+     n      vertex count\n\
+     count  number of digraphs to write (default 1)\n\
+"
+#endif
+
+/* Built like gsinksL4 (see makefile): 64-bit setwords, up to 256 vertices. */
+#ifndef MAXN
+#define MAXN WORDSIZE
+#endif
+
+#include "gtools.h"
+
+static graph g[MAXN*MAXM];
+static int relabel[MAXN];
+static int sccstart[MAXN+1];    // -c: SCC k is vertices sccstart[k]..sccstart[k+1]-1
+
+static unsigned long long rngstate;
+
+static void
+seedrng(long seed)
+{
+    // never start xorshift from 0
+    rngstate = 0x9E3779B97F4A7C15ULL * (unsigned long long)(seed + 1);
+}
+
+static unsigned long long
+rng(void)
+/* xorshift64* */
+{
+    rngstate ^= rngstate >> 12;
+    rngstate ^= rngstate << 25;
+    rngstate ^= rngstate >> 27;
+    return rngstate * 0x2545F4914F6CDD1DULL;
+}
+
+static boolean
+chance(double p)
+/* TRUE with probability p. */
+{
+    return (rng() >> 11) * (1.0 / 9007199254740992.0) < p;
+}
+
+static void
+shuffle(int *p, int n)
+{
+    int i,j,t;
+
+    for (i = 0; i < n; ++i) p[i] = i;
+    for (i = n-1; i > 0; --i)
+    {
+        j = rng() % (i+1);
+        t = p[i]; p[i] = p[j]; p[j] = t;
+    }
+}
+
+static void
+addarc(int i, int j, int m)
+/* Add the arc i->j, in the random labelling. */
+{
+    ADDELEMENT(GRAPHROW(g,relabel[i],m),relabel[j]);
+}
+
+/**************************************************************************/
+
+static void
+makerandom(double p, int m, int n)
+{
+    int i,j;
+
+    for (i = 0; i < n; ++i)
+        for (j = 0; j < n; ++j)
+            if (i != j && chance(p)) addarc(i,j,m);
+}
+
+static void
+maketournament(int m, int n)
+{
+    int i,j;
+
+    for (i = 0; i < n; ++i)
+        for (j = i+1; j < n; ++j)
+            if (rng() & 1) addarc(i,j,m);
+            else           addarc(j,i,m);
+}
+
+static void
+makecycles(int len, int m, int n)
+{
+    int i,c;
+
+    for (c = 0; c + len <= n; c += len)
+        for (i = 0; i < len; ++i)
+            addarc(c+i,c+(i+1)%len,m);
+}
+
+static void
+makesccs(double p, int nsccs, int nleaves, int m, int n)
+/* nsccs SCCs of sizes as equal as can be, in a topological order, of which
+   the last nleaves are the leaves. */
+{
+    int i,j,k,size,later;
+    boolean out;
+
+    for (k = 0; k <= nsccs; ++k) sccstart[k] = (int)((long)k * n / nsccs);
+
+    for (k = 0; k < nsccs; ++k)
+    {
+        size = sccstart[k+1] - sccstart[k];
+        // a cycle through the SCC makes it strongly connected
+        if (size > 1)
+            for (i = sccstart[k]; i < sccstart[k+1]; ++i)
+                addarc(i,i+1 < sccstart[k+1] ? i+1 : sccstart[k],m);
+        for (i = sccstart[k]; i < sccstart[k+1]; ++i)
+            for (j = sccstart[k]; j < sccstart[k+1]; ++j)
+                if (i != j && chance(p)) addarc(i,j,m);
+
+        if (k >= nsccs - nleaves) continue;     // a leaf: no arcs out
+
+        out = FALSE;
+        for (i = sccstart[k]; i < sccstart[k+1]; ++i)
+            for (j = sccstart[k+1]; j < n; ++j)
+                if (chance(p))
+                {
+                    addarc(i,j,m);
+                    out = TRUE;
+                }
+        if (!out)
+        {
+            i = sccstart[k] + rng() % size;
+            later = sccstart[k+1] + rng() % (n - sccstart[k+1]);
+            addarc(i,later,m);
+        }
+    }
+}
+
+static void
+makedigraph(double p, int nsccs, int nleaves, int cyclelen, boolean tournament,
+            boolean loops, int m, int n)
+/* Make the next digraph in g: with nsccs SCCs if that is > 0, else a union
+   of cycles if cyclelen > 0, else a tournament if asked, else random. */
+{
+    int i;
+
+    EMPTYGRAPH(g,m,n);
+    shuffle(relabel,n);
+    if (nsccs > 0)         makesccs(p,nsccs,nleaves,m,n);
+    else if (cyclelen > 0) makecycles(cyclelen,m,n);
+    else if (tournament)   maketournament(m,n);
+    else                   makerandom(p,m,n);
+    if (loops)
+        for (i = 0; i < n; ++i)
+            if (chance(p)) addarc(i,i,m);
+}
+
+/**************************************************************************/
+
+#ifndef NOMAIN
+int
+main(int argc, char *argv[])
+{
+    int j,n,m;
+    char *arg;
+    char *endptr;
+    boolean badargs,tswitch,lswitch;
+    double p;
+    long nsccs,nleaves,cyclelen,seed,count,k,nargs,val;
+
+    HELP; PUTVERSION;
+
+    nauty_check(WORDSIZE,1,1,NAUTYVERSIONID);
+
+    // default values
+    p = 0.3;
+    nsccs = 0;
+    nleaves = 0;
+    cyclelen = 0;
+    tswitch = FALSE;
+    lswitch = FALSE;
+    seed = 1;
+    n = 0;
+    count = 1;
+    nargs = 0;
+
+    badargs = FALSE;
+    for (j = 1; !badargs && j < argc; ++j)
+    {
+        arg = argv[j];
+        if (arg[0] == '-' && arg[1] != '\0')
+        {
+            switch (arg[1]) {
+                case 't': tswitch = TRUE; break;
+                case 'l': lswitch = TRUE; break;
+                case 'p':
+                    p = strtod(arg+2,&endptr);
+                    if (endptr == arg+2 || *endptr != '\0' || p < 0 || p > 1)
+                        badargs = TRUE;
+                    break;
+                case 'c': case 'L': case 'y': case 'S':
+                    val = strtol(arg+2,&endptr,10);
+                    if (endptr == arg+2 || *endptr != '\0' || val < 0)
+                        badargs = TRUE;
+                    else if (arg[1] == 'c') nsccs = val;
+                    else if (arg[1] == 'L') nleaves = val;
+                    else if (arg[1] == 'y') cyclelen = val;
+                    else seed = val;
+                    break;
+                default: badargs = TRUE;
+            }
+        }
+        else
+        {
+            val = strtol(arg,&endptr,10);
+            if (*endptr != '\0' || val <= 0) badargs = TRUE;
+            else if (nargs == 0) n = val > MAXN ? MAXN+1 : (int)val;
+            else if (nargs == 1) count = val;
+            else badargs = TRUE;
+            ++nargs;
+        }
+    }
+    if (nargs == 0) badargs = TRUE;
+    if ((nsccs > 0) + (cyclelen > 0) + tswitch > 1) badargs = TRUE;
+    if (nleaves > 0 && nsccs == 0) badargs = TRUE;
+
+    if (badargs)
+    {
+        fprintf(stderr,">E Usage: %s\n",USAGE);
+        GETHELP;
+        exit(1);
+    }
+
+    if (n > MAXN)
+    {
+        fprintf(stderr,">E gendig: n must be at most %d\n",MAXN);
+        exit(1);
+    }
+    if (nsccs > 0)
+    {
+        if (nleaves == 0) nleaves = 1;
+        if (nsccs > n || nleaves > nsccs)
+        {
+            fprintf(stderr,">E gendig: need leaves <= SCCs <= n\n");
+            exit(1);
+        }
+    }
+    if (cyclelen == 1 || cyclelen > n)
+    {
+        fprintf(stderr,">E gendig: the cycle length must be 2 to n\n");
+        exit(1);
+    }
+
+    m = SETWORDSNEEDED(n);
+    seedrng(seed);
+
+    for (k = 0; k < count; ++k)
+    {
+        makedigraph(p,(int)nsccs,(int)nleaves,(int)cyclelen,tswitch,lswitch,m,n);
+        writed6(stdout,g,m,n);
+    }
+    exit(0);
+}
+#endif
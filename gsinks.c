@@ -32,7 +32,9 @@ SEE readme.MD
 */
 
 #define USAGE \
-  "gsinks [opts] N"
+  "gsinks [opts] [--by-indegree] [--sources] [--profile-graphs FILE]\
+ [--progress[=#]] [--metrics-file FILE] [--trace FILE] [--perf]\
+ [N | -i FILE ...]"
 
 #define HELPTEXT \
 " gsinks : generate and count digraphs with one global sink\n\
@@ -40,16 +42,71 @@ SEE readme.MD
      -q     don't show total count for the number of vertices\n\
      -d     generate, and show in d6 formmat \n\
      -l     self-loops allowed \n\
+     -r     find SCCs from bitset reachability instead of tarjan\n\
+     -b     find leaf SCCs from bitset reachability, many graphs at a time\n\
+     -s     count colourings 64 at a time in bitsliced form, for graphs\n\
+            with small groups (ignored with -d)\n\
+     -v     time the stages, and report after each count (to stderr)\n\
+     -e#:#  only digraphs where the new sink has in-degree in this range;\n\
+            either end may be left out, and -e# means exactly #\n\
+     --by-indegree  also show the counts by in-degree of the new sink,\n\
+            as a polynomial in x\n\
+     --sources  also count the digraphs with one global source made by\n\
+            adding arcs out of the new vertex instead, from the same\n\
+            group computation (shown as >S; -d writes only the sinks)\n\
+     --profile-graphs FILE  write a CSV record per input graph to FILE\n\
+            (n, SCCs, leaf SCCs, group size, count, ns), and list the\n\
+            slowest graphs of each input on stderr\n\
+     --progress[=#]  show progress on stderr every # seconds (default 5);\n\
+            SIGUSR1 shows it at any time\n\
+     --metrics-file FILE  keep FILE up to date with counters in the\n\
+            Prometheus text format, at the --progress interval\n\
+     --trace FILE  write a timeline of the stages to FILE at exit, as\n\
+            Chrome trace JSON\n\
+     --perf  count cycles, instructions, branch and cache misses in the\n\
+            stages (Linux perf_event_open), and report them with -v's\n\
+     -i FILE  read digraphs from FILE instead of dig[l]N.d6, or from stdin\n\
+            if FILE is - ; can be given more than once, with a count\n\
+            for each FILE. The vertex counts are taken from the data.\n\
      N      vertex count  (default: start at 1 and go up)\n\
+            counts above 32 are handed over to gsinksL (up to 64)\n\
+            and from there to gsinksL4 (up to 256)\n\
 "
 
-/* Nauty-required definitions before any includes */
-#define MAXN 32 
+/* Nauty-required definitions before any includes.
+   The default build uses 32-bit setwords and nautyW1. The gsinksL build
+   (see makefile) overrides these with WORDSIZE 64 and MAXN 64 and links nautyL1,
+   and gsinksL4 uses MAXN 256 (sets of up to 4 words) with the dynamic nautyL. */
+#ifndef WORDSIZE
 #define WORDSIZE 32
+#endif
+#ifndef MAXN
+#define MAXN WORDSIZE
+#endif
 
 #include "gtools.h"
 #include "naugroup.h"
 #include "nautinv.h"
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+// The engine for graphs too big for this build, run by main() via exec.
+// It is expected to sit in the same directory as this executable.
+#if MAXN == 32
+#define WIDE_ENGINE "gsinksL"
+#elif MAXN == 64
+#define WIDE_ENGINE "gsinksL4"
+#endif
 
 
 // From vcolg.c
@@ -57,42 +114,191 @@ static int col[MAXN];
 static boolean first;
 static int lastreject[MAXN];
 static boolean lastrejok;
-static unsigned long groupsize;
+typedef unsigned __int128 count128;
+static count128 groupsize;      // 0 if it doesn't fit
 static unsigned long newgroupsize;
 static int fail_level;
 
 // switches
-static boolean qswitch, dswitch, lswitch;
-
-// for counting and generating digraphs with one global sink
-static long long totalCount = 0;
+static boolean qswitch, dswitch, lswitch, rswitch, bswitch, sswitch;
+static long mine, maxe;     // -e: limits on the in-degree of the new sink
+static boolean indegswitch; // --by-indegree
+static boolean sourceswitch; // --sources
+static boolean vswitch;     // -v: time the stages
+static boolean tracing;     // --trace: record the stages as a timeline
+static boolean perfing;     // --perf: count hardware events in the stages
+static boolean timing;      // vswitch || tracing || perfing
+static FILE *profilefile;   // --profile-graphs: a record per input graph
+static long progresssecs;   // --progress: seconds between progress lines, or 0
+static char *metricsname;   // --metrics-file: rewritten with the timer
+
+// for counting and generating digraphs with one global sink.
+// totalCount is the hot-path counter. colourdigraph folds it into the
+// big-integer bigTotal before it can overflow, and main folds in the rest
+// at the end of each N, so only the per-N reduction pays for bignums.
+static count128 totalCount = 0;
+
+#define BIGBASE 1000000000U     // bignums are base 10^9, least significant first
+#define BIGLIMBS 16
+struct bigcount {unsigned int limb[BIGLIMBS]; int len;};
+static struct bigcount bigTotal;
+
+// With --by-indegree, indegCount[k] counts the digraphs in totalCount whose
+// new sink has in-degree k (k colour-1 vertices), and bigIndeg[k] their totals.
+// Each indegCount[k] is at most totalCount, so they are reduced together.
+static count128 indegCount[MAXN+1];
+static struct bigcount bigIndeg[MAXN+1];
+static long long graphCount = 0;    // input graphs coloured so far, for this N
+static count128 graphStart;         // totalCount when the current graph began
+
+// With --sources, the digraphs with one global source made by adding arcs
+// from the new vertex instead. These are counted alongside totalCount, by
+// the same colourings, as Aut(G) is also the group of its converse.
+static count128 sourceCount = 0;
+static struct bigcount bigSources;
+
+// Per-graph working storage. Everything a graph needs lives here or on the
+// stack, and is overwritten by the next graph, so that the steady-state loop
+// makes no heap allocations. nauty's group records are recycled by nauty
+// itself as long as groupptr() is called with cutloose FALSE, and its
+// other work areas (and gconv) only grow.
+static struct {
+    graph g[MAXN*MAXM];         // the input graph, as read
+    graph gnew[MAXN*MAXM];      // with -d, the input graph plus the new sink
+    graph gconv[MAXN*MAXM];     // with --sources, the converse of g
+    int mout;                   // setwords per row of gnew
+} arena;
+
+#ifdef ALLOCCOUNT
+// Count heap allocations (glibc only), to check the claim above.
+// Built as gsinksA; prints a >A line after each count.
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t,size_t);
+extern void *__libc_realloc(void*,size_t);
+static long long allocations = 0;
+static long long allocmark = 0;     // allocations before the second graph
+void *malloc(size_t size) { ++allocations; return __libc_malloc(size); }
+void *calloc(size_t n, size_t size) { ++allocations; return __libc_calloc(n,size); }
+void *realloc(void *p, size_t size) { ++allocations; return __libc_realloc(p,size); }
+#endif
+
+#ifdef PRUNECOUNT
+// Count what the orderly scan does, to see how well it prunes.
+// Built as gsinksC; prints >C lines after each count.
+static struct {
+    long long nodes;        // colours tried by scan, at any level
+    long long tries;        // complete colourings given to trythisone
+    long long accepts;      // of those, the ones found maximal
+    long long lastrejhits;  // rejected by the last rejecting element alone
+    long long order2;       // accepted by the groupsize 2 shortcut
+    long long allgroups;    // full allgroup2 runs
+    long long elements;     // non-identity elements tested by those runs
+    long long leafrejects;  // accepted, then failed the leaf SCC filter
+    // the graphs that take the whole-space enumerators instead of the scan
+    long long scangraphs,graygraphs,slicegraphs;
+    long long graysteps;    // colourings visited by graycolour
+    long long graytries;    // of those, in prev[] order and the edge limits,
+                            // all maximal as the group is trivial
+    long long grayleafrejects;  // of those, failing the leaf SCC filter
+    long long sliceblocks;  // blocks of 64 colourings done by slicecolour
+    long long slicetries;   // colourings in prev[] order and the edge limits
+    long long sliceaccepts; // of those, the ones found maximal
+    long long sliceleafrejects; // of those, failing the leaf SCC filter
+} prunecounts;
+#define PRUNECOUNTER(c) (++prunecounts.c)
+#define PRUNECOUNTADD(c,k) (prunecounts.c += (k))
+#else
+#define PRUNECOUNTER(c)
+#define PRUNECOUNTADD(c,k)
+#endif
 
 // for tarjan algorithm 
 // trajan breaks graphs into strongly connected components (SCCs)
 // and the connections between SCCs is a directed acyclic graph (DAG)
-struct sccinfo {setword sccVertices; boolean isLeaf; int sccSize;};
-struct sccinfo sccinfos[MAXN];
-int currentSCC;
-boolean isFirstSCC;
-struct vinfo {int index; int lowlink; boolean onstack; set descendents;};
-struct vinfo vinfos[MAXN];
-static int vertex_index = 0;
+struct sccinfo {set sccVertices[MAXM]; boolean isLeaf; int sccSize;};
+struct vinfo {int epoch; int index; int lowlink; boolean onstack; set descendents[MAXM];};
 #define UNDEFINED (-1)
 
-// a very simple integer stack implementation, used by tarjan
-static int stack[MAXN];     
-static int stack_top = -1;  
-static int pop() {
-    int data = stack[stack_top];
-    stack_top--;   
-    return data;
+// Everything the SCC code works on, so that it is reentrant: each graph being
+// worked on at the same time needs its own sccstate. vinfos[v] only belongs
+// to the current graph if its epoch matches, so starting a graph doesn't
+// need to clear vinfos, and vertex_index starts again at 0 for each graph.
+// An sccstate has to start out zeroed, as the static ones here do.
+struct sccstate {
+    struct sccinfo sccinfos[MAXN];  // the SCCs found
+    int currentSCC;                 // how many SCCs were found
+    boolean isFirstSCC;
+    struct vinfo vinfos[MAXN];
+    int vertex_index;
+    int epoch;
+    int stack[MAXN];                // a very simple integer stack
+    int stack_top;
+};
+
+static struct sccstate sinkscc;             // the SCCs of the input graph
+static struct sccstate *sccs = &sinkscc;    // the SCCs the colouring stage uses
+static struct sccstate sourcescc;           // with --sources, those of its converse
+static struct sccstate *srcs = &sourcescc;
+
+// Operations on m-word sets used by the SCC code. Single-word builds
+// reduce to plain word operations; otherwise m = 1, 2 and 4 are unrolled.
+#if MAXM == 1
+#define SETUNION(s1,s2,m) ((s1)[0] |= (s2)[0])
+#define ISSUBSET(s1,s2,m) (SETDIFF((s1)[0],(s2)[0]) == 0)
+#else
+#define SETUNION(s1,s2,m) setunion(s1,s2,m)
+#define ISSUBSET(s1,s2,m) issubset(s1,s2,m)
+
+static void
+setunion(set *s1, set *s2, int m)
+/* s1 := s1 union s2 */
+{
+    int i;
+
+    switch (m)
+    {
+        case 4: s1[3] |= s2[3]; s1[2] |= s2[2];  /* FALLTHROUGH */
+        case 2: s1[1] |= s2[1];                  /* FALLTHROUGH */
+        case 1: s1[0] |= s2[0]; break;
+        default: for (i = 0; i < m; ++i) s1[i] |= s2[i];
+    }
 }
-static int push(int data) {
-    stack_top++;   
-    stack[stack_top] = data;
+
+static boolean
+issubset(set *s1, set *s2, int m)
+/* test if s1 is a subset of s2 */
+{
+    int i;
+
+    switch (m)
+    {
+        case 4: return (SETDIFF(s1[0],s2[0]) | SETDIFF(s1[1],s2[1])
+                      | SETDIFF(s1[2],s2[2]) | SETDIFF(s1[3],s2[3])) == 0;
+        case 2: return (SETDIFF(s1[0],s2[0]) | SETDIFF(s1[1],s2[1])) == 0;
+        case 1: return SETDIFF(s1[0],s2[0]) == 0;
+        default:
+            for (i = 0; i < m; ++i)
+                if (SETDIFF(s1[i],s2[i]) != 0) return FALSE;
+            return TRUE;
+    }
+}
+#endif
+
+// the stack used by tarjan
+static int pop(struct sccstate *ctx) {
+    return ctx->stack[ctx->stack_top--];
 }
+static void push(struct sccstate *ctx, int data) {
+    ctx->stack[++ctx->stack_top] = data;
+}
+
 
 
+// The colouring kernels below (filter_and_output, ismax, testmax, trythisone
+// and scan) are always inlined, so that each instantiation further down gets
+// its own copy with n as a compile-time constant. Every input file has a
+// single n, so main() picks the instantiation once per file.
+#define KERNEL static inline __attribute__((always_inline))
 
 // A callout from colour_digraph code, as digraphs get colored.  
 // Every node colored '1' will be connected to the new global sink vertex.
@@ -101,54 +307,588 @@ static int push(int data) {
 // rejects the graph colorings that don't fulfill  that requirement, and, 
 // if requested, contructs and outputs every graph that meets the requirement. 
 
-void filter_and_output(graph*,int*,int,int);
-void filter_and_output(graph* g,int* col,int m,int n){
-    set * gi;
-    int i,j;
+static void
+bigadd(struct bigcount *big, count128 x)
+/* big += x */
+{
+    unsigned long long carry;
+    int i;
+
+    carry = 0;
+    for (i = 0; x > 0 || carry > 0; ++i)
+    {
+        if (i == BIGLIMBS) gt_abort(">E gsinks: count too large\n");
+        if (i >= big->len) big->limb[big->len++] = 0;
+        carry += big->limb[i] + (unsigned long long)(x % BIGBASE);
+        x /= BIGBASE;
+        big->limb[i] = carry % BIGBASE;
+        carry /= BIGBASE;
+    }
+}
+
+static char *
+bigtostring(struct bigcount *big)
+/* Decimal form of big, in a static buffer. */
+{
+    static char buf[BIGLIMBS*9+1];
+    char *p;
+    int i;
+
+    if (big->len == 0) return strcpy(buf,"0");
+    p = buf + sprintf(buf,"%u",big->limb[big->len-1]);
+    for (i = big->len-2; i >= 0; --i) p += sprintf(p,"%09u",big->limb[i]);
+    return buf;
+}
+
+static void
+reducecount(void)
+/* Move totalCount into bigTotal, and likewise for the in-degree
+   and source counts. */
+{
+    int k;
+
+    bigadd(&bigTotal,totalCount);
+    totalCount = 0;
+    bigadd(&bigSources,sourceCount);
+    sourceCount = 0;
+    if (indegswitch)
+        for (k = 0; k <= MAXN; ++k)
+        {
+            bigadd(&bigIndeg[k],indegCount[k]);
+            indegCount[k] = 0;
+        }
+}
+
+static void
+writeindegrees(void)
+/* Write the in-degree polynomial to stderr,
+   as ">P sum of c*x^k" with the zero terms left out. */
+{
+    boolean firstterm;
+    int k;
+
+    fprintf(stderr,">P");
+    firstterm = TRUE;
+    for (k = 0; k <= MAXN; ++k)
+    {
+        if (bigIndeg[k].len == 0) continue;
+        fprintf(stderr,"%s%s",firstterm ? " " : " + ",bigtostring(&bigIndeg[k]));
+        if (k == 1) fprintf(stderr,"*x");
+        else if (k > 1) fprintf(stderr,"*x^%d",k);
+        firstterm = FALSE;
+    }
+    if (firstterm) fprintf(stderr," 0");
+    fprintf(stderr,"\n");
+    for (k = 0; k <= MAXN; ++k) bigIndeg[k].len = 0;
+}
+
+/**************************************************************************/
+
+// Stage timers for -v and --trace. Each stage keeps its total time and a histogram of
+// the times of single calls, in buckets a quarter of a power of two wide, so
+// that percentiles come without storing the times. Only one call in
+// GRAPHSAMPLE is timed for the stages run once per graph (or per batch, for
+// -b's SCCs), and one in TIMESAMPLE for the group tests and the output, which
+// run many times per graph; the totals are scaled up from those. Without -v
+// --trace or --perf a timer costs a test of timing. The scan stage includes
+// the maxtest and output stages.
+
+enum {T_DECODE, T_SCC, T_NAUTY, T_COSETS, T_SCAN, T_MAXTEST, T_OUTPUT, NSTAGES};
+
+#define GRAPHSAMPLE 4
+#define TIMESAMPLE 16
+#define TIMEBUCKETS (4*64)
+#define PERFCOUNTERS 5      // hardware events counted with --perf
+
+struct stagetimer {
+    const char *name;
+    int every;                      // time one call in this many
+    long long calls;
+    long long timed;
+    double ns;                      // total over the timed calls
+    long long maxns;
+    long long hist[TIMEBUCKETS];
+    double donens;                  // the estimated totals of earlier counts
+    unsigned long long perf[PERFCOUNTERS];  // over the timed calls
+    unsigned long long perfstart[PERFCOUNTERS];
+    double spanns;                  // over the timed calls in this --trace span
+    long long spantimed;
+    long long spancalls;            // calls when the span started
+};
+
+static struct stagetimer stagetimers[NSTAGES] = {
+    {"decode",GRAPHSAMPLE}, {"scc",GRAPHSAMPLE}, {"nauty",GRAPHSAMPLE},
+    {"cosetreps",GRAPHSAMPLE}, {"scan",GRAPHSAMPLE},
+    {"maxtest",TIMESAMPLE}, {"output",TIMESAMPLE}};
+
+static long long
+nanotime(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// t0 is 0 unless this call is timed.
+#define TIMER_START(st,t0) \
+    ((t0) = (timing && stagetimers[st].calls++ % stagetimers[st].every == 0) \
+            ? stagestart(st) : 0)
+#define TIMER_STOP(st,t0) \
+    { if (t0) stagetimed(st, t0, nanotime()); }
+
+static void perfread(unsigned long long *values);
+
+static long long
+stagestart(int st)
+{
+    if (perfing) perfread(stagetimers[st].perfstart);
+    return nanotime();
+}
+
+static void
+stagetimed(int st, long long start, long long end)
+{
+    struct stagetimer *t = &stagetimers[st];
+    long long ns = end - start;
+    unsigned long long now[PERFCOUNTERS];
+    int b;
+
+    if (perfing)
+    {
+        perfread(now);
+        for (b = 0; b < PERFCOUNTERS; ++b) t->perf[b] += now[b] - t->perfstart[b];
+    }
+    t->spanns += ns;
+    ++t->spantimed;
+    t->ns += ns;
+    ++t->timed;
+    if (ns > t->maxns) t->maxns = ns;
+    if (ns < 4)
+        b = ns > 0 ? ns : 0;
+    else
+    {
+        b = 63 - __builtin_clzll(ns);
+        b = 4*b + ((ns >> (b-2)) & 3);
+    }
+    ++t->hist[b];
+}
+
+static double
+stagens(struct stagetimer *t)
+/* The estimated total time of the stage for this count, in ns. */
+{
+    return t->timed > 0 ? t->ns * ((double)t->calls / t->timed) : 0;
+}
+
+static double
+percentile(struct stagetimer *t, double q)
+/* The time below which a fraction q of the timed calls fall, in ns, to
+   within a bucket. */
+{
+    long long want,seen;
+    int b;
+
+    want = (long long)(q * t->timed);
+    seen = 0;
+    for (b = 0; b < TIMEBUCKETS; ++b)
+    {
+        seen += t->hist[b];
+        if (seen > want) break;
+    }
+    if (b < 4) return b;
+    // the top of bucket b, but no more than the largest time seen
+    if (((4 + (b & 3) + 1LL) << (b/4 - 2)) > t->maxns) return t->maxns;
+    return (double)((4 + (b & 3) + 1LL) << (b/4 - 2));
+}
+
+static void
+writetimes(long long graphs)
+/* Write the -v report for the graphs just done to stderr, and reset. */
+{
+    struct stagetimer *t;
+    double total;
+    int st;
+
+    fprintf(stderr,">V %lld graphs; per call: p50, p90, p99 and max in us\n",
+            graphs);
+    fprintf(stderr,">V %-10s %12s %10s %11s %9s %9s %9s %9s\n","stage","calls",
+            "total s","us/graph","p50","p90","p99","max");
+    for (st = 0; st < NSTAGES; ++st)
+    {
+        t = &stagetimers[st];
+        total = stagens(t);
+        t->donens += total;
+        if (t->timed > 0)
+        {
+            fprintf(stderr,">V %-10s %12lld %10.3f %11.3f %9.3f %9.3f %9.3f %9.3f\n",
+                    t->name, t->calls, total/1e9,
+                    graphs > 0 ? total/1e3/graphs : 0.0,
+                    percentile(t,0.5)/1e3, percentile(t,0.9)/1e3,
+                    percentile(t,0.99)/1e3, t->maxns/1e3);
+        }
+        t->calls = t->timed = t->maxns = t->spancalls = 0;
+        t->ns = 0;
+        memset(t->hist, 0, sizeof(t->hist));
+        memset(t->perf, 0, sizeof(t->perf));
+    }
+}
+
+/**************************************************************************/
+
+// The --trace timeline: each input, and a "graphs" span for every TRACEGRAPHS
+// graphs, as complete events in the Chrome trace JSON format, for
+// chrome://tracing or Perfetto. Inside each span are the estimated times of
+// the stages in it, laid end to end (maxtest and output inside scan), as the
+// stages of different graphs interleave. The stage timers sample calls as for
+// -v, so a long run can be traced at little cost. gsinks is single-threaded,
+// so the events go into one buffer allocated at the start, without locks,
+// and are written out at exit. Events past TRACEEVENTS are dropped and
+// counted.
+
+#define TRACEGRAPHS 4096
+#define TRACEEVENTS (1L << 18)  // at 8 events a span, 2^27 graphs
+
+struct traceevent {const char *name; long long start; long long ns; long long graphs;};
+static struct traceevent *traceevents;
+static long ntraceevents, tracedropped;
+static char *tracename;
+static FILE *tracefile;
+static long long tracestart;
+static long long spanstart, spangraphs;     // the span being gathered
+
+static void
+traceadd(const char *name, long long start, long long ns, long long graphs)
+{
+    if (ntraceevents == TRACEEVENTS)
+    {
+        ++tracedropped;
+        return;
+    }
+    traceevents[ntraceevents].name = name;
+    traceevents[ntraceevents].start = start;
+    traceevents[ntraceevents].ns = ns;
+    traceevents[ntraceevents].graphs = graphs;
+    ++ntraceevents;
+}
+
+static void
+tracespan(void)
+/* Add the span of the graphs coloured since the last one, and start another. */
+{
+    struct stagetimer *t;
+    long long now,at,end,scanstart,ns;
+    int st;
+
+    now = nanotime();
+    if (spangraphs > 0)
+    {
+        traceadd("graphs",spanstart,now - spanstart,spangraphs);
+        at = scanstart = spanstart;
+        end = now;
+        for (st = 0; st < NSTAGES; ++st)
+        {
+            t = &stagetimers[st];
+            ns = t->spantimed > 0 ? (long long)(t->spanns
+                    * ((double)(t->calls - t->spancalls) / t->spantimed)) : 0;
+            if (st == T_SCAN) scanstart = at;
+            if (st == T_MAXTEST)
+            {
+                end = at;           // the end of scan
+                at = scanstart;
+            }
+            if (at + ns > end) ns = end - at;
+            if (ns > 0) traceadd(t->name,at,ns,0);
+            at += ns;
+        }
+    }
+    for (st = 0; st < NSTAGES; ++st)
+    {
+        stagetimers[st].spanns = 0;
+        stagetimers[st].spantimed = 0;
+        stagetimers[st].spancalls = stagetimers[st].calls;
+    }
+    spanstart = now;
+    spangraphs = 0;
+}
+
+static void
+jsonstring(FILE *f, const char *s)
+{
+    putc('"',f);
+    for (; *s; ++s)
+        if (*s == '"' || *s == '\\') fprintf(f,"\\%c",*s);
+        else if ((unsigned char)*s < ' ') fprintf(f,"\\u%04x",*s);
+        else putc(*s,f);
+    putc('"',f);
+}
+
+static void
+writetrace(void)
+/* Write the trace to tracefile. Called at exit. */
+{
+    FILE *f = tracefile;
+    long i;
+    int pid;
+
+    pid = (int)getpid();
+    fprintf(f,"{\"traceEvents\":[\n"
+              "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":1,"
+              "\"args\":{\"name\":\"gsinks\"}}",pid);
+    for (i = 0; i < ntraceevents; ++i)
+    {
+        fprintf(f,",\n{\"name\":");
+        jsonstring(f,traceevents[i].name);
+        fprintf(f,",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":1",
+                (traceevents[i].start - tracestart) / 1e3,
+                traceevents[i].ns / 1e3, pid);
+        if (traceevents[i].graphs > 0)
+            fprintf(f,",\"args\":{\"graphs\":%lld}",traceevents[i].graphs);
+        fprintf(f,"}");
+    }
+    fprintf(f,"\n],\"displayTimeUnit\":\"ns\"}\n");
+    if (fclose(f) != 0)
+        fprintf(stderr,">E gsinks: can't write %s: %s\n",tracename,strerror(errno));
+    if (tracedropped > 0)
+        fprintf(stderr,">T trace buffer full: %ld events kept, %ld dropped\n",
+                ntraceevents, tracedropped);
+}
+
+static void
+starttrace(void)
+/* Open the trace file, so that a bad name stops the run before it starts. */
+{
+    if ((tracefile = fopen(tracename,"w")) == NULL)
+    {
+        fprintf(stderr,">E gsinks: can't open %s: %s\n",tracename,strerror(errno));
+        exit(1);
+    }
+    traceevents = malloc(TRACEEVENTS * sizeof(struct traceevent));
+    if (!traceevents) gt_abort(">E gsinks: malloc failed\n");
+    tracestart = nanotime();
+    tracespan();
+    atexit(writetrace);
+}
+
+/**************************************************************************/
+
+// --perf counts hardware events in the timed calls of each stage, with
+// perf_event_open (Linux only): cycles, instructions, branch misses, L1 data
+// read misses and last-level cache misses, all in user mode. The counters are
+// one group, read together at the ends of each timed call, and scaled up by
+// calls/timed like the times. Events the CPU or the kernel don't provide read
+// as 0. Reading them is a system call, so this is slower than -v.
+
+static const char *perfname[PERFCOUNTERS] =
+    {"cycles", "instructions", "branch-misses", "L1d-misses", "LLC-misses"};
+static int perfslot[PERFCOUNTERS];  // where each event is in a group read, or -1
+static int perfgroup = -1;          // the group leader's fd
+static int nperfopen;
+
+static void
+perfread(unsigned long long *values)
+{
+    unsigned long long buf[1+PERFCOUNTERS];
+    int i;
+
+    if (read(perfgroup, buf, sizeof(buf)) < (ssize_t)sizeof(buf[0]))
+        buf[0] = 0;
+    for (i = 0; i < PERFCOUNTERS; ++i)
+        values[i] = (perfslot[i] >= 0 && perfslot[i] < (int)buf[0])
+                    ? buf[1+perfslot[i]] : 0;
+}
+
+static boolean
+startperf(void)
+/* Open the counters. Return FALSE if the first, cycles, can't be. */
+{
+#ifdef __linux__
+    struct perf_event_attr attr;
+    unsigned int type[PERFCOUNTERS] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+        PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE};
+    unsigned long long config[PERFCOUNTERS] = {PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+            | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        PERF_COUNT_HW_CACHE_MISSES};
+    int i,fd;
+
+    nperfopen = 0;
+    for (i = 0; i < PERFCOUNTERS; ++i)
+    {
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type[i];
+        attr.config = config[i];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        fd = syscall(__NR_perf_event_open, &attr, 0, -1, perfgroup, 0);
+        if (fd < 0)
+        {
+            if (i == 0)
+            {
+                fprintf(stderr,">E gsinks: --perf can't open the cycle counter: %s\n"
+                        "   (see /proc/sys/kernel/perf_event_paranoid)\n",
+                        strerror(errno));
+                return FALSE;
+            }
+            perfslot[i] = -1;
+            continue;
+        }
+        if (i == 0) perfgroup = fd;
+        perfslot[i] = nperfopen++;
+    }
+    return TRUE;
+#else
+    fprintf(stderr,">E gsinks: --perf needs Linux perf_event_open\n");
+    return FALSE;
+#endif
+}
+
+static void
+writeperf(void)
+/* Write the --perf report for the count just done to stderr. */
+{
+    struct stagetimer *t;
+    double scale,c[PERFCOUNTERS];
+    int st,i;
+
+    // the misses are per thousand instructions
+    fprintf(stderr,">H %-10s %12s %12s %6s","stage",perfname[0],perfname[1],"IPC");
+    for (i = 2; i < PERFCOUNTERS; ++i) fprintf(stderr," %13s",perfname[i]);
+    fprintf(stderr,"\n");
+    for (st = 0; st < NSTAGES; ++st)
+    {
+        t = &stagetimers[st];
+        if (t->timed == 0) continue;
+        scale = (double)t->calls / t->timed;
+        for (i = 0; i < PERFCOUNTERS; ++i) c[i] = t->perf[i] * scale;
+        fprintf(stderr,">H %-10s %12.4g %12.4g %6.2f",t->name,c[0],c[1],
+                c[0] > 0 ? c[1]/c[0] : 0.0);
+        for (i = 2; i < PERFCOUNTERS; ++i)
+            if (perfslot[i] < 0) fprintf(stderr," %13s","-");
+            else fprintf(stderr," %13.3f", c[1] > 0 ? 1000*c[i]/c[1] : 0.0);
+        fprintf(stderr,"\n");
+    }
+}
+
+static count128
+grpsize(statsblk *stats)
+/* The group size from nauty as grpsize1 * 10^grpsize2, or 0 if that is
+   too big for a count128 (2^128 is about 3.4e38). */
+{
+    long double size;
+    int i;
+
+    if (stats->grpsize2 == 0 && stats->grpsize1 < 1e15)
+        return (count128)(stats->grpsize1 + 0.1);
+    size = stats->grpsize1;
+    for (i = 0; i < stats->grpsize2; ++i) size *= 10;
+    if (size >= 3.0e38L) return 0;
+    return (count128)(size + 0.5L);
+}
+
+static void
+startoutput(graph *g, int m, int n)
+/* Set up arena.gnew as g plus an isolated new vertex n. The colourings
+   only ever change the arcs into n. */
+{
+    int j;
+
+    arena.mout = SETWORDSNEEDED(n+1);
+    EMPTYGRAPH(arena.gnew,arena.mout,n+1);
+    if (arena.mout == m)
+        memcpy(arena.gnew, g, n * m * sizeof(set));
+    else
+        for (j=0; j<n; j++)
+            memcpy(GRAPHROW(arena.gnew,j,arena.mout), GRAPHROW(g,j,m), m * sizeof(set));
+}
+
+KERNEL boolean
+leavescoloured(struct sccstate *ctx, int *col, setword coloured, int m)
+/* Test if every leaf SCC in ctx has a vertex coloured 1. Single-word builds
+   test against coloured, the set of those vertices, instead of col. */
+{
+    int i;
+#if MAXM == 1
+    for (i=0; i<ctx->currentSCC; i++)
+        if (ctx->sccinfos[i].isLeaf && (ctx->sccinfos[i].sccVertices[0] & coloured) == 0)
+            return FALSE;
+#else
+    int j;
     boolean leafcoloured;
-    
-    // reject graphs that don't have at least one '1' in every SCC leaf
-    for (i=0; i<currentSCC; i++)
+
+    for (i=0; i<ctx->currentSCC; i++)
     {
-        if (!sccinfos[i].isLeaf) continue;
+        if (!ctx->sccinfos[i].isLeaf) continue;
         
         leafcoloured = FALSE;
-        j = nextelement(&sccinfos[i].sccVertices,m,UNDEFINED);
+        j = nextelement(ctx->sccinfos[i].sccVertices,m,UNDEFINED);
         do
         {
             if (col[j]) {
                 leafcoloured = TRUE;
                 break;
             }
-            j = nextelement(&sccinfos[i].sccVertices,m,j);
+            j = nextelement(ctx->sccinfos[i].sccVertices,m,j);
         } while (j != UNDEFINED);
-        if (FALSE == leafcoloured) return;
+        if (FALSE == leafcoloured) return FALSE;
+    }
+#endif
+    return TRUE;
+}
+
+KERNEL void
+filter_and_output(graph* g,int* col,int m,int n,long sofar){
+    set * gi;
+    int j;
+    setword coloured;
+    long long t0;
+    
+    coloured = 0;
+#if MAXM == 1
+    for (j=0; j<n; j++)
+        if (col[j]) coloured |= bit[j];
+#endif
+
+    // with --sources, the same colouring read as arcs out of the new vertex
+    // gives a global source if it colours every leaf SCC of the converse
+    if (sourceswitch && leavescoloured(srcs,col,coloured,m)) sourceCount++;
+
+    // reject graphs that don't have at least one '1' in every SCC leaf
+    if (!leavescoloured(sccs,col,coloured,m))
+    {
+        PRUNECOUNTER(leafrejects);
+        return;
     }
    
-    // Now create the actual single-sink digraphs by adding a new edge & connecting all colored edges to it. 
+    // Now create the actual single-sink digraphs by connecting all colored
+    // vertices to the new vertex set up by startoutput.
     if (dswitch)
     {
-        graph gnew [MAXN*MAXM];
-        EMPTYGRAPH(gnew,m,n+1);
-        memcpy(gnew, g, n * sizeof(set));
-        
+        TIMER_START(T_OUTPUT,t0);
         for (j=0; j<n; j++)
         {
-            if (col[j]){
-                gi = GRAPHROW(gnew,j,m);
+            gi = GRAPHROW(arena.gnew,j,arena.mout);
+            if (col[j])
                 ADDELEMENT(gi,n);    
-            }
+            else
+                DELELEMENT(gi,n);
         }
-        writed6(stdout, gnew, m, n+1);  
+        writed6(stdout, arena.gnew, arena.mout, n+1);  
+        TIMER_STOP(T_OUTPUT,t0);
     }
     totalCount++;
+    // sofar is the number of vertices coloured 1
+    if (indegswitch) ++indegCount[sofar];
 }
 
 /**************************************************************************/
 //Code from vcolg.c, simplified where possible
 
 
-static int
+KERNEL int
 ismax(int *p, int n)
 /* test if col^p <= col */
 {
@@ -174,7 +914,7 @@ ismax(int *p, int n)
 
 /**************************************************************************/
 
-static void
+KERNEL void
 testmax(int *p, int n, int *abort)
 /* Called by allgroup2. */
 {
@@ -186,6 +926,7 @@ testmax(int *p, int n, int *abort)
         return;
     }
 
+    PRUNECOUNTER(elements);
     if (!ismax(p,n))
     {
         *abort = 1;
@@ -196,38 +937,55 @@ testmax(int *p, int n, int *abort)
 
 /**************************************************************************/
 
-static int
-trythisone(grouprec *group, graph *g, boolean digraph, int m, int n)
+typedef void testmaxproc(int*,int,int*);
+
+KERNEL int
+trythisone(grouprec *group, graph *g, int m, int n, testmaxproc *tester,
+           long sofar)
 /* Try one solution, accept if maximal. */
 /* Return value is level to return to. */
+/* tester is the testmax instantiation for this n, to pass to allgroup2,
+   and sofar the sum of the colours. */
 {
-    int i,j;
     boolean accept;
-    graph *gi;
-    size_t ne;
+    long long t0;
 
     newgroupsize = 1;
+    PRUNECOUNTER(tries);
 
     if (!group || groupsize == 1)
         accept = TRUE;
-    else if (lastrejok && !ismax(lastreject,n))
-        accept = FALSE;
-    else if (lastrejok && groupsize == 2)
-        accept = TRUE;
     else
     {
-        newgroupsize = 1;
-        first = TRUE;
-
-        if (allgroup2(group,testmax) == 0)
+        TIMER_START(T_MAXTEST,t0);
+        if (lastrejok && !ismax(lastreject,n))
+        {
+            PRUNECOUNTER(lastrejhits);
+            accept = FALSE;
+        }
+        else if (lastrejok && groupsize == 2)
+        {
+            PRUNECOUNTER(order2);
             accept = TRUE;
+        }
         else
-            accept = FALSE;
+        {
+            PRUNECOUNTER(allgroups);
+            newgroupsize = 1;
+            first = TRUE;
+
+            if (allgroup2(group,tester) == 0)
+                accept = TRUE;
+            else
+                accept = FALSE;
+        }
+        TIMER_STOP(T_MAXTEST,t0);
     }
 
     if (accept)
     {        
-        filter_and_output(g,col,m,n);
+        PRUNECOUNTER(accepts);
+        filter_and_output(g,col,m,n,sofar);
 
         return n-1;
     }
@@ -237,34 +995,540 @@ trythisone(grouprec *group, graph *g, boolean digraph, int m, int n)
 
 /**************************************************************************/
 
+KERNEL void
+scan(graph *g, int *prev, long minedges, long maxedges,
+    long numcols, grouprec *group, int m, int n, testmaxproc *tester)
+/* Scan for default case, written as a loop so that it can be inlined.
+   Each level of the original recursion keeps its colour in col[level],
+   its upper limit in hi[level] and the total before it in sofar[level].
+   ret is the level to return to, as in vcolg. */
+{
+    int level,left;
+    long min,max,ret;
+    long hi[MAXN+1],sofar[MAXN+1];
+
+    level = 0;
+    sofar[0] = 0;
+    for (;;)
+    {
+        /* descend from level */
+        if (level == n)
+            ret = trythisone(group,g,m,n,tester,sofar[n]);
+        else
+        {
+            left = n - level - 1;
+            min = minedges - sofar[level] - (numcols-1)*left;
+            if (min < 0) min = 0;
+            max = maxedges - sofar[level];
+            if (max >= numcols) max = numcols - 1;
+            if (prev[level] >= 0 && col[prev[level]] < max)
+                max = col[prev[level]];
+
+            if (min <= max)
+            {
+                PRUNECOUNTER(nodes);
+                col[level] = min;
+                hi[level] = max;
+                sofar[level+1] = sofar[level] + min;
+                ++level;
+                continue;
+            }
+            ret = level-1;
+        }
+
+        /* return ret to the enclosing levels */
+        for (--level; level >= 0; --level)
+        {
+            if (ret < level) continue;
+            if (col[level] < hi[level])
+            {
+                PRUNECOUNTER(nodes);
+                ++col[level];
+                sofar[level+1] = sofar[level] + col[level];
+                break;
+            }
+            ret = level-1;
+        }
+        if (level < 0) return;
+        ++level;
+    }
+}
+
+/**************************************************************************/
+
+// One instantiation of the kernels per vertex count up to SCANKERNELS,
+// plus scan_any for everything else. The output graphs have n+1 vertices,
+// so n = 32 only exists in the wider builds.
+typedef void scanproc(graph*,int*,long,long,long,grouprec*,int,int);
+
+#if MAXN > 32
+#define SCANKERNELS 32
+#else
+#define SCANKERNELS (MAXN-1)
+#endif
+#define SCAN_KERNEL(N) \
+static void testmax_##N(int *p, int n, int *abort) { testmax(p,N,abort); } \
+static void scan_##N(graph *g, int *prev, long minedges, long maxedges, \
+                     long numcols, grouprec *group, int m, int n) \
+{ scan(g,prev,minedges,maxedges,numcols,group,m,N,testmax_##N); }
+
+static void testmax_any(int *p, int n, int *abort) { testmax(p,n,abort); }
+static void scan_any(graph *g, int *prev, long minedges, long maxedges,
+                     long numcols, grouprec *group, int m, int n)
+{ scan(g,prev,minedges,maxedges,numcols,group,m,n,testmax_any); }
+
+SCAN_KERNEL(1)  SCAN_KERNEL(2)  SCAN_KERNEL(3)  SCAN_KERNEL(4)
+SCAN_KERNEL(5)  SCAN_KERNEL(6)  SCAN_KERNEL(7)  SCAN_KERNEL(8)
+SCAN_KERNEL(9)  SCAN_KERNEL(10) SCAN_KERNEL(11) SCAN_KERNEL(12)
+SCAN_KERNEL(13) SCAN_KERNEL(14) SCAN_KERNEL(15) SCAN_KERNEL(16)
+SCAN_KERNEL(17) SCAN_KERNEL(18) SCAN_KERNEL(19) SCAN_KERNEL(20)
+SCAN_KERNEL(21) SCAN_KERNEL(22) SCAN_KERNEL(23) SCAN_KERNEL(24)
+SCAN_KERNEL(25) SCAN_KERNEL(26) SCAN_KERNEL(27) SCAN_KERNEL(28)
+SCAN_KERNEL(29) SCAN_KERNEL(30) SCAN_KERNEL(31)
+#if SCANKERNELS == 32
+SCAN_KERNEL(32)
+#endif
+
+static scanproc *const scankernels[SCANKERNELS+1] = {scan_any,
+    scan_1,  scan_2,  scan_3,  scan_4,  scan_5,  scan_6,  scan_7,  scan_8,
+    scan_9,  scan_10, scan_11, scan_12, scan_13, scan_14, scan_15, scan_16,
+    scan_17, scan_18, scan_19, scan_20, scan_21, scan_22, scan_23, scan_24,
+    scan_25, scan_26, scan_27, scan_28, scan_29, scan_30, scan_31,
+#if SCANKERNELS == 32
+    scan_32
+#endif
+};
+
+// The scan instantiation for the current input n, set by selectkernels()
+static scanproc *scankernel = scan_any;
+static int scankernel_n = UNDEFINED;
+
+static void
+selectkernels(int n)
+{
+    scankernel = (n <= SCANKERNELS) ? scankernels[n] : scan_any;
+    scankernel_n = n;
+}
+
+/**************************************************************************/
+
+// Rigid graphs accept every colouring that passes the leaf filter, so the
+// orderly scan has nothing to prune. graycolour visits all 2^n colourings in
+// Gray-code order instead, each differing from the one before in a single
+// vertex, and keeps running counts so that every step is O(1):
+// leaf SCCs with no coloured vertex, broken prev[] constraints (twins are
+// still ordered by prev[] even when the group is trivial), and coloured
+// vertices for the edge limits. With -d, the output graph from startoutput
+// is patched in place. With --sources, the leaf SCCs of the converse are
+// tracked the same way.
+
+#define GRAYMAXN 62
+
+static void
+graycolour(graph *g, int *prev, long minedges, long maxedges, int m, int n)
+{
+    int leafof[MAXN];       // leaf SCC number of each vertex, or UNDEFINED
+    int leafcount[MAXN];    // number of coloured vertices in each leaf SCC
+    int srcof[MAXN],srccount[MAXN];     // the same for the converse
+    int kid[MAXN],nextkid[MAXN];    // the i with prev[i] = v, as lists
+    int nleaves,uncovered,srcuncovered,violations,sofar;
+    int i,j,k,v;
+    unsigned long step,last;
+    long long t0;
+
+#define VIOLATIONS(v,count) \
+    { count = (prev[v] >= 0 && col[v] > col[prev[v]]); \
+      for (k = kid[v]; k >= 0; k = nextkid[k]) count += (col[k] > col[v]); }
+
+    for (i = 0; i < n; ++i)
+    {
+        col[i] = 0;
+        leafof[i] = UNDEFINED;
+        srcof[i] = UNDEFINED;
+        kid[i] = UNDEFINED;
+    }
+    for (i = n-1; i >= 0; --i)
+        if (prev[i] >= 0)
+        {
+            nextkid[i] = kid[prev[i]];
+            kid[prev[i]] = i;
+        }
+
+    nleaves = 0;
+    for (i = 0; i < sccs->currentSCC; i++)
+    {
+        if (!sccs->sccinfos[i].isLeaf) continue;
+        for (j = nextelement(sccs->sccinfos[i].sccVertices,m,UNDEFINED); j >= 0;
+             j = nextelement(sccs->sccinfos[i].sccVertices,m,j))
+            leafof[j] = nleaves;
+        leafcount[nleaves++] = 0;
+    }
+    uncovered = nleaves;
+
+    nleaves = 0;
+    if (sourceswitch)
+        for (i = 0; i < srcs->currentSCC; i++)
+        {
+            if (!srcs->sccinfos[i].isLeaf) continue;
+            for (j = nextelement(srcs->sccinfos[i].sccVertices,m,UNDEFINED); j >= 0;
+                 j = nextelement(srcs->sccinfos[i].sccVertices,m,j))
+                srcof[j] = nleaves;
+            srccount[nleaves++] = 0;
+        }
+    srcuncovered = nleaves;
+    violations = 0;
+    sofar = 0;
+
+    if (dswitch)
+        for (j = 0; j < n; j++) DELELEMENT(GRAPHROW(arena.gnew,j,arena.mout),n);
+
+    last = (1UL << n) - 1;
+    PRUNECOUNTER(graygraphs);
+    PRUNECOUNTADD(graysteps,last + 1);
+    for (step = 0; ; )
+    {
+        if (violations == 0 && sofar >= minedges && sofar <= maxedges)
+        {
+            PRUNECOUNTER(graytries);
+            if (uncovered != 0) PRUNECOUNTER(grayleafrejects);
+            if (uncovered == 0)
+            {
+                if (dswitch)
+                {
+                    TIMER_START(T_OUTPUT,t0);
+                    writed6(stdout, arena.gnew, arena.mout, n+1);
+                    TIMER_STOP(T_OUTPUT,t0);
+                }
+                totalCount++;
+                if (indegswitch) ++indegCount[sofar];
+            }
+            if (sourceswitch && srcuncovered == 0) sourceCount++;
+        }
+        if (step == last) break;
+
+        v = __builtin_ctzl(++step);
+        VIOLATIONS(v,j);
+        violations -= j;
+        col[v] ^= 1;
+        VIOLATIONS(v,j);
+        violations += j;
+        if (col[v])
+        {
+            ++sofar;
+            if (leafof[v] >= 0 && leafcount[leafof[v]]++ == 0) --uncovered;
+            if (srcof[v] >= 0 && srccount[srcof[v]]++ == 0) --srcuncovered;
+        }
+        else
+        {
+            --sofar;
+            if (leafof[v] >= 0 && --leafcount[leafof[v]] == 0) ++uncovered;
+            if (srcof[v] >= 0 && --srccount[srcof[v]] == 0) ++srcuncovered;
+        }
+        if (dswitch) FLIPELEMENT(GRAPHROW(arena.gnew,v,arena.mout),n);
+    }
+#undef VIOLATIONS
+}
+
+/**************************************************************************/
+
+// Bitsliced counting (-s) for rigid and small-group graphs: colouring number c
+// gives vertex v the colour (c >> v) & 1, and 64 consecutive colourings are
+// held as one word per vertex, bit t of W[v] being the colour of v in the
+// colouring 64*block + t. The leaf filter is then an OR over each leaf
+// SCC and an AND over the leaves, the prev[] constraints and the ismax test
+// for each group element are a few word operations per vertex, and each
+// block yields 64 verdicts at once. This accepts exactly what the scan does.
+
+typedef unsigned long long bitslice;
+
+#define SLICEMAXN 30        // at most 2^24 blocks per graph
+#define SMALLGROUP 64       // the most group elements worth testing this way
+
+static const bitslice slicepattern[6] = {
+    0xAAAAAAAAAAAAAAAAULL, 0xCCCCCCCCCCCCCCCCULL, 0xF0F0F0F0F0F0F0F0ULL,
+    0xFF00FF00FF00FF00ULL, 0xFFFF0000FFFF0000ULL, 0xFFFFFFFF00000000ULL};
+
+static int smallgroup[SMALLGROUP][MAXN];
+static int smallgroupsize;
+
+static void
+storeperm(int *p, int n, int *abort)
+/* Called by allgroup2, to list the non-identity elements of the group. */
+{
+    if (first)
+    {
+        first = FALSE;
+        return;
+    }
+    memcpy(smallgroup[smallgroupsize++], p, n * sizeof(int));
+}
+
 static int
-scan(int level, graph *g, boolean digraph, int *prev, long minedges, long maxedges,
-    long sofar, long numcols, grouprec *group, int m, int n)
-/* Recursive scan for default case */
-/* Returned value is level to return to. */
+sliceleaves(struct sccstate *ctx, bitslice *lowor, unsigned long *highmask, int m)
+/* Set lowor[] and highmask[] for each leaf SCC in ctx, and return how many. */
+{
+    int nleaves,i,j;
+
+    nleaves = 0;
+    for (i = 0; i < ctx->currentSCC; i++)
+    {
+        if (!ctx->sccinfos[i].isLeaf) continue;
+        lowor[nleaves] = 0;
+        highmask[nleaves] = 0;
+        for (j = nextelement(ctx->sccinfos[i].sccVertices,m,UNDEFINED); j >= 0;
+             j = nextelement(ctx->sccinfos[i].sccVertices,m,j))
+            if (j < 6) lowor[nleaves] |= slicepattern[j];
+            else       highmask[nleaves] |= 1UL << (j-6);
+        ++nleaves;
+    }
+    return nleaves;
+}
+
+static void
+slicecolour(graph *g, int *prev, long minedges, long maxedges,
+            grouprec *group, int m, int n)
 {
-    int left;
-    long min,max,k,ret;
+    bitslice lowor[MAXN];           // leaf vertices below 6, as patterns
+    unsigned long highmask[MAXN];   // leaf vertices from 6 up, as bits of block
+    bitslice srclowor[MAXN];        // the same for the converse, with --sources
+    unsigned long srchighmask[MAXN];
+    bitslice popmask[7];            // the t in 0..63 with k bits set
+    bitslice W[MAXN];
+    bitslice ok,sinkok,srcok,leafok,gt,eq,a,c;
+#ifdef PRUNECOUNT
+    bitslice edgeok;
+#endif
+    unsigned long block,nblocks;
+    int nleaves,nsrcleaves,i,j,k,t,*p;
+
+    smallgroupsize = 0;
+    if (group && groupsize > 1)
+    {
+        first = TRUE;
+        allgroup2(group,storeperm);
+    }
+
+    nleaves = sliceleaves(sccs,lowor,highmask,m);
+    nsrcleaves = sourceswitch ? sliceleaves(srcs,srclowor,srchighmask,m) : 0;
 
-    if (level == n)
-        return trythisone(group,g,digraph,m,n);
+    for (k = 0; k <= 6; ++k) popmask[k] = 0;
+    for (t = 0; t < 64; ++t) popmask[__builtin_popcount(t)] |= 1ULL << t;
 
-    left = n - level - 1;
-    min = minedges - sofar - numcols*left;
-    if (min < 0) min = 0;
-    max = maxedges - sofar;
-    if (max >= numcols) max = numcols - 1;
-    if (prev[level] >= 0 && col[prev[level]] < max)
-	max = col[prev[level]];
+    for (j = 0; j < n && j < 6; ++j) W[j] = slicepattern[j];
+    nblocks = (n > 6) ? 1UL << (n-6) : 1;
 
-    for (k = min; k <= max; ++k)
+    PRUNECOUNTER(slicegraphs);
+    PRUNECOUNTADD(sliceblocks,nblocks);
+    for (block = 0; block < nblocks; ++block)
     {
-        col[level] = k;
-        ret = scan(level+1,g,digraph,prev,minedges,maxedges,sofar+k,numcols,group,m,n);
-	if (ret < level) return ret;
+        ok = (n >= 6) ? ~0ULL : (1ULL << (1 << n)) - 1;
+
+        // edge limits: the number of coloured vertices is t's plus block's
+        if (minedges > 0 || maxedges < n)
+        {
+            leafok = 0;
+            j = __builtin_popcountl(block);
+            for (k = 0; k <= 6; ++k)
+                if (k + j >= minedges && k + j <= maxedges) leafok |= popmask[k];
+            ok &= leafok;
+        }
+#ifdef PRUNECOUNT
+        edgeok = ok;
+#endif
+
+        sinkok = ok;
+        for (i = 0; sinkok && i < nleaves; ++i)
+            if ((block & highmask[i]) == 0) sinkok &= lowor[i];
+        srcok = 0;
+        if (sourceswitch)
+        {
+            srcok = ok;
+            for (i = 0; srcok && i < nsrcleaves; ++i)
+                if ((block & srchighmask[i]) == 0) srcok &= srclowor[i];
+        }
+        ok = sinkok | srcok;
+#ifdef PRUNECOUNT
+        // carry on with the leaf rejects too, to count them; sinkok and
+        // srcok still decide what is counted
+        ok = edgeok;
+#endif
+        if (!ok) continue;
+
+        for (j = 6; j < n; ++j) W[j] = -(bitslice)((block >> (j-6)) & 1);
+
+        for (i = 0; i < n; ++i)
+            if (prev[i] >= 0) ok &= ~(W[i] & ~W[prev[i]]);
+
+        PRUNECOUNTADD(slicetries,__builtin_popcountll(ok));
+        // col^p <= col: find where col^p first differs from col
+        for (k = 0; ok && k < smallgroupsize; ++k)
+        {
+            p = smallgroup[k];
+            gt = 0;
+            eq = ~0ULL;
+            for (i = 0; eq && i < n; ++i)
+            {
+                a = W[p[i]];
+                c = W[i];
+                gt |= eq & a & ~c;
+                eq &= ~(a ^ c);
+            }
+            ok &= ~gt;
+        }
+
+        PRUNECOUNTADD(sliceaccepts,__builtin_popcountll(ok));
+        PRUNECOUNTADD(sliceleafrejects,__builtin_popcountll(ok & ~sinkok));
+        sourceCount += __builtin_popcountll(ok & srcok);
+        ok &= sinkok;
+        totalCount += __builtin_popcountll(ok);
+        if (indegswitch && ok)
+        {
+            j = __builtin_popcountl(block);
+            for (k = 0; k <= 6; ++k)
+                indegCount[k + j] += __builtin_popcountll(ok & popmask[k]);
+        }
+    }
+}
+
+/**************************************************************************/
+
+// Twins (vertices i and j with the same in- and out-neighbours, either not
+// adjacent to each other or adjacent both ways) are interchangeable, and the
+// scan orders their colours through prev[] instead of leaving the swap in the
+// group. findtwins looks them up by hashing rows in one pass: the out-row for
+// twins that are not adjacent, and the out-row with the vertex's own element
+// added for twins adjacent both ways (the loops having been removed). A hit is
+// checked exactly, first on the out-rows alone. Only when that finds some
+// twins is the converse built, to check the in-rows as well.
+
+#define TWINTABLE (2*MAXN)    // hash slots, kept at most half full
+
+static unsigned long
+rowhash(set *row, int m, int v, boolean withself, boolean loop)
+{
+    unsigned long h;
+    int k;
+
+    h = loop ? 0x9E3779B97F4A7C15UL : 0;
+    if (withself) FLIPELEMENT(row,v);
+    for (k = 0; k < m; ++k) h = (h ^ row[k]) * 0x100000001B3UL;
+    if (withself) FLIPELEMENT(row,v);
+    return h ^ (h >> 29);
+}
+
+static boolean
+sametwins(graph *g, graph *gconv, boolean *loop, int i, int j,
+          boolean withself, int m)
+/* Test if i and j are twins of the kind given by withself, looking at
+   in-rows only if gconv is not NULL. */
+{
+    set *gi,*gj,*gci,*gcj;
+    boolean same;
+    int k;
+
+    gi = GRAPHROW(g,i,m);
+    gj = GRAPHROW(g,j,m);
+    if (loop[i] != loop[j] || ISELEMENT(gi,j) != withself
+                           || ISELEMENT(gj,i) != withself) return FALSE;
+
+    if (withself) { FLIPELEMENT(gi,i); FLIPELEMENT(gj,j); }
+    for (k = 0; k < m; ++k) if (gi[k] != gj[k]) break;
+    if (withself) { FLIPELEMENT(gi,i); FLIPELEMENT(gj,j); }
+    same = (k == m);
+
+    if (same && gconv)
+    {
+        gci = GRAPHROW(gconv,i,m);
+        gcj = GRAPHROW(gconv,j,m);
+        if (withself) { FLIPELEMENT(gci,i); FLIPELEMENT(gcj,j); }
+        for (k = 0; k < m; ++k) if (gci[k] != gcj[k]) break;
+        if (withself) { FLIPELEMENT(gci,i); FLIPELEMENT(gcj,j); }
+        same = (k == m);
+    }
+    return same;
+}
+
+static boolean
+findtwins(graph *g, graph *gconv, boolean *loop, int nfixed,
+          int *prev, int m, int n)
+/* Set prev[i] to the most recent twin of i in the same region (0..nfixed-1
+   or nfixed..n-1), or -1 if there is none. Return whether there were any. */
+{
+    int table[2][TWINTABLE];    // the last vertex seen in each slot, or -1
+    int i,j,s,kind,start;
+    boolean found;
+    unsigned long h;
+
+    found = FALSE;
+    start = 0;
+    for (i = 0; i < n; ++i)
+    {
+        if (i == start)
+            for (s = 0; s < TWINTABLE; ++s) table[0][s] = table[1][s] = -1;
+
+        prev[i] = -1;
+        for (kind = 0; kind < 2; ++kind)
+        {
+            h = rowhash(GRAPHROW(g,i,m),m,i,kind,loop[i]);
+            if (gconv) h = h * 31 + rowhash(GRAPHROW(gconv,i,m),m,i,kind,FALSE);
+            for (s = h % TWINTABLE; (j = table[kind][s]) >= 0;
+                                                  s = (s + 1) % TWINTABLE)
+                if (sametwins(g,gconv,loop,i,j,kind,m)) break;
+            table[kind][s] = i;
+            if (j > prev[i]) prev[i] = j;
+        }
+        if (prev[i] >= 0) found = TRUE;
+
+        if (i == nfixed-1) start = nfixed;
+    }
+    return found;
+}
+
+/**************************************************************************/
+
+static double
+prevspace(int *prev, int n)
+/* The number of 2-colourings with col[i] <= col[prev[i]] wherever prev[i] >= 0,
+   the part of the 2^n that the scan visits. prev[] is a forest with
+   prev[i] < i: colouring i 0 forces its subtree to 0, colouring it 1 leaves
+   its children free. */
+{
+    double kids[MAXN],space;
+    int i;
+
+    for (i = 0; i < n; ++i) kids[i] = 1;
+    space = 1;
+    for (i = n-1; i >= 0; --i)
+        if (prev[i] >= 0) kids[prev[i]] *= 1 + kids[i];
+        else              space *= 1 + kids[i];
+    return space;
+}
+
+static boolean
+widelimits(int *prev, long minedges, long maxedges, int perstep, int n)
+/* Test if the colourings that keep the prev[] order and are within the edge
+   limits (taking the two as independent) are at least a quarter of the
+   steps of a whole-space enumerator that covers perstep of the 2^n
+   colourings in a step: 1 for graycolour, 64 for a slicecolour block. If
+   not, it would mostly visit colourings that the scan prunes away; twins
+   alone (edgeless digraphs have n+1 of 2^n) are enough for that. n <= 62. */
+{
+    double binom,inrange;
+    int k;
+
+    inrange = (double)(1UL << n);
+    if (minedges > 0 || maxedges < n)
+    {
+        binom = 1;
+        inrange = 0;
+        for (k = 0; k <= n; ++k)
+        {
+            if (k >= minedges && k <= maxedges) inrange += binom;
+            binom = binom * (n-k) / (k+1);
+        }
     }
-
-    return level-1;
+    return prevspace(prev,n) / (double)(1UL << n) * inrange * 4 * perstep
+               >= (double)(1UL << n);
 }
 
 /**************************************************************************/
@@ -277,21 +1541,27 @@ colourdigraph(graph *g, int nfixed, long minedges, long maxedges,
     statsblk stats;
     setword workspace[MAXN];
     grouprec *group;
-    int i,j,k,nloops;
+    int i,j,nloops;
     size_t ii;
-    set *gi,*gj,*gci,*gcj;
+    set *gi;
     int lab[MAXN],ptn[MAXN],orbits[MAXN];
     boolean loop[MAXN];
     int prev[MAXN]; /* If >= 0, earlier point that must have greater colour */
     int weight[MAXN];
-    int region,start,stop;
+    long long t0;
     DYNALLSTAT(graph,gconv,gconv_sz);
 
     if (n > MAXN) gt_abort(">E vcolg: MAXN exceeded\n");
+#ifdef ALLOCCOUNT
+    if (graphCount == 1) allocmark = allocations;
+#endif
+    ++graphCount;
+    // no graph can add 2^64 colourings, so this keeps totalCount from overflowing
+    if ((totalCount | sourceCount) >> 126) reducecount();
+    graphStart = totalCount;
+    groupsize = 1;
     
 
-    DYNALLOC2(graph,gconv,gconv_sz,n,m,"colourdigraph");
-
     nloops = 0;
     for (i = 0, gi = g; i < n; ++i, gi += m)
         if (ISELEMENT(gi,i))
@@ -303,61 +1573,18 @@ colourdigraph(graph *g, int nfixed, long minedges, long maxedges,
 	else
 	    loop[i] = FALSE;
 
-    for (ii = 0; ii < m*(size_t)n; ++ii) gconv[ii] = g[ii];
-    converse(gconv,m,n);
-
-    for (region = 0; region < 2; ++region)
+    if (findtwins(g,NULL,loop,nfixed,prev,m,n))
     {
-	if (region == 0)
-	{
-	    if (nfixed == 0) continue;
-	    start = 0;
-	    stop = nfixed;
-	    if (stop > n) stop = n;
-	}
-	else
-	{
-	    if (nfixed >= n) continue;
-	    start = nfixed;
-	    stop = n;
-	}
-	
-	for (i = start,
-                    gi = g + m*(size_t)start, gci = gconv + m*(size_t)start;
-             i < stop; ++i, gi += m, gci += m)
-	{
-            /* Find most recent equivalent j. */
-	    for (j = i-1, gj = gi-m, gcj = gci-m; j >= start;
-                                                   --j, gj -= m, gcj -= m)
-	    {
-		if (loop[j] != loop[i]
-                       || ISELEMENT(gi,j) != ISELEMENT(gj,i)) continue;
-		for (k = 0; k < m; ++k)
-                     if (gi[k] != gj[k] || gci[k] != gcj[k]) break;
-		if (k < m)
-		{
-		    FLIPELEMENT(gi,i); FLIPELEMENT(gj,j);
-		    FLIPELEMENT(gci,i); FLIPELEMENT(gcj,j);
-		    for (k = 0; k < m; ++k)
-                        if (gi[k] != gj[k] || gci[k] != gcj[k]) break;
-		    FLIPELEMENT(gci,i); FLIPELEMENT(gcj,j);
-		    FLIPELEMENT(gi,i); FLIPELEMENT(gj,j);
-		}
-		if (k == m) break;
-	    }
-	    if (j >= start)
-	    {
-		prev[i] = j;
-		weight[i] = weight[j] + 1;
-	    }
-	    else
-	    {
-		prev[i] = -1;
-		weight[i] = 0;
-	    }
-	}
+        // the out-rows have twins, so the in-rows are needed after all
+        DYNALLOC2(graph,gconv,gconv_sz,n,m,"colourdigraph");
+        for (ii = 0; ii < m*(size_t)n; ++ii) gconv[ii] = g[ii];
+        converse(gconv,m,n);
+        findtwins(g,gconv,loop,nfixed,prev,m,n);
     }
 
+    for (i = 0; i < n; ++i)
+        weight[i] = (prev[i] >= 0) ? weight[prev[i]] + 1 : 0;
+
     for (i = nfixed; i < n; ++i) weight[i] += nfixed;
 
     if (maxedges == NOLIMIT || maxedges > n*numcols) maxedges = n*numcols;
@@ -365,7 +1592,8 @@ colourdigraph(graph *g, int nfixed, long minedges, long maxedges,
 
     if (n == 0)
     {
-        scan(0,g,TRUE,prev,minedges,maxedges,0,numcols,FALSE,m,n);
+        if (dswitch) startoutput(g,m,n);
+        scan_any(g,prev,minedges,maxedges,numcols,NULL,m,n);
         return;
     }
 
@@ -382,15 +1610,18 @@ colourdigraph(graph *g, int nfixed, long minedges, long maxedges,
         for (i = 0, gi = g; i < n; ++i, gi += m)
 	    if (loop[i]) ADDELEMENT(gi,i);
  
+    TIMER_START(T_NAUTY,t0);
     nauty(g,lab,ptn,NULL,orbits,&options,&stats,workspace,MAXN,m,n,NULL);
+    TIMER_STOP(T_NAUTY,t0);
 
-    if (stats.grpsize2 == 0)
-        groupsize = stats.grpsize1 + 0.1;
-    else
-        groupsize = 0;
+    if (dswitch) startoutput(g,m,n);
+
+    groupsize = grpsize(&stats);
 
+    TIMER_START(T_COSETS,t0);
     group = groupptr(FALSE);
     makecosetreps(group);
+    TIMER_STOP(T_COSETS,t0);
 
     if (stats.numorbits < n)
     {
@@ -402,81 +1633,81 @@ colourdigraph(graph *g, int nfixed, long minedges, long maxedges,
 	    if (orbits[i] == j) prev[i] = j;
     }
 
-    lastrejok = FALSE;
-    for (i = 0; i < n; ++i) col[i] = 0;
+    TIMER_START(T_SCAN,t0);
+    if (sswitch && !dswitch && numcols == 2 && n <= SLICEMAXN
+            && groupsize >= 1 && groupsize <= SMALLGROUP
+            && widelimits(prev,minedges,maxedges,64,n))
+        slicecolour(g,prev,minedges,maxedges,group,m,n);
+    else if (groupsize == 1 && numcols == 2 && n <= GRAYMAXN
+            && widelimits(prev,minedges,maxedges,1,n))
+        graycolour(g,prev,minedges,maxedges,m,n);
+    else
+    {
+        PRUNECOUNTER(scangraphs);
+        lastrejok = FALSE;
+        for (i = 0; i < n; ++i) col[i] = 0;
 
-    scan(0,g,TRUE,prev,minedges,maxedges,0,numcols,group,m,n);
+        (*scankernel)(g,prev,minedges,maxedges,numcols,group,m,n);
+    }
+    TIMER_STOP(T_SCAN,t0);
 }
 
 /***************************/
 // TARJAN algorithm
 /*********************/
 
-void tarjan(graph * g, int m, int n);
-void strongconnect(graph * g,int v,int n,int m);
+void tarjan(struct sccstate *ctx, graph * g, int m, int n);
+static void strongconnect(struct sccstate *ctx, graph * g, int v, int m);
 
-void tarjan(graph * g, int m, int n)
+void tarjan(struct sccstate *ctx, graph * g, int m, int n)
 {
-    int i,j;
-     
-    stack_top = -1;
-    currentSCC = 0;
-    isFirstSCC = TRUE;
+    int v;
     
-    for (i=0; i<n; i++){ 
-        vinfos[i].index = UNDEFINED;
-        vinfos[i].lowlink = UNDEFINED;
-        vinfos[i].onstack = FALSE;
-        EMPTYSET(&vinfos[i].descendents,m);
-        
-        EMPTYSET(&sccinfos[i].sccVertices,m);
-        sccinfos[i].isLeaf = FALSE;
-        sccinfos[i].sccSize = 0;
+    if (++ctx->epoch == INT_MAX)
+    {
+        // out of epochs, so start again
+        for (v=0; v<MAXN; v++) ctx->vinfos[v].epoch = 0;
+        ctx->epoch = 1;
     }
+    ctx->vertex_index = 0;
+    ctx->stack_top = -1;
+    ctx->currentSCC = 0;
+    ctx->isFirstSCC = TRUE;
     
-    
-    for (int v=0; v<n; v++)
+    for (v=0; v<n; v++)
     {
-        if (UNDEFINED == vinfos[v].index){
-            strongconnect(g,v,n,m);
+        if (ctx->vinfos[v].epoch != ctx->epoch){
+            strongconnect(ctx,g,v,m);
         }
     }
-    for (i=0; i<currentSCC; i++)
-    {
-        j = nextelement(&sccinfos[i].sccVertices,m,UNDEFINED);
-        do
-        {
-            j = nextelement(&sccinfos[i].sccVertices,m,j);
-        } while (j != UNDEFINED);
-        if (sccinfos[i].isLeaf)
-        {
-        }
-    }    
-    
 }
 
-void strongconnect(graph * g,int v,int n,int m)
+static void strongconnect(struct sccstate *ctx, graph * g, int v, int m)
 {
+    struct vinfo *vinfos = ctx->vinfos;
+    struct sccinfo *scc;
     set * gp;
     int w = UNDEFINED;
-    setword descendents;
+    set descendents[MAXM];
     int sccSize;
     
-    vinfos[v].index = vertex_index;
-    vinfos[v].lowlink = vertex_index;
-    vertex_index++;
-    push(v);
+    vinfos[v].epoch = ctx->epoch;
+    vinfos[v].index = ctx->vertex_index;
+    vinfos[v].lowlink = ctx->vertex_index;
+    ctx->vertex_index++;
+    push(ctx,v);
     vinfos[v].onstack = TRUE;
+    EMPTYSET(vinfos[v].descendents,m);
     
     gp = GRAPHROW(g,v,m);
     w = nextelement(gp,m,w);
     
     for (; w > UNDEFINED; w = nextelement(gp,m,w))
     {
-        ADDELEMENT(&vinfos[v].descendents,w);
-        if (vinfos[w].index == UNDEFINED)
+        ADDELEMENT(vinfos[v].descendents,w);
+        if (vinfos[w].epoch != ctx->epoch)
         {
-            strongconnect(g,w,n,m);
+            strongconnect(ctx,g,w,m);
             
             if (vinfos[v].lowlink > vinfos[w].lowlink)
             {
@@ -491,36 +1722,589 @@ void strongconnect(graph * g,int v,int n,int m)
             }
         }
     }  
-    EMPTYSET(&descendents, m);
+    EMPTYSET(descendents, m);
     
     if (vinfos[v].lowlink == vinfos[v].index){
         sccSize=0;
         // start a new strongly connected component
+        scc = &ctx->sccinfos[ctx->currentSCC];
+        EMPTYSET(scc->sccVertices,m);
+        scc->isLeaf = FALSE;
         do {
-            w = pop();
+            w = pop(ctx);
             vinfos[w].onstack = FALSE;
             sccSize++;
             // add w to current strongly connected component
-            ADDELEMENT(&sccinfos[currentSCC].sccVertices, w);
+            ADDELEMENT(scc->sccVertices, w);
             // accumulate descendents to check for leafiness
-            ADDELEMENT(&descendents, w);
-            descendents = UNION(descendents,vinfos[w].descendents);
+            ADDELEMENT(descendents, w);
+            SETUNION(descendents,vinfos[w].descendents,m);
         } while (w != v);
-        sccinfos[currentSCC].sccSize = sccSize;
+        scc->sccSize = sccSize;
         
         
-        if (isFirstSCC){
-            sccinfos[currentSCC].isLeaf = TRUE;
-            isFirstSCC = FALSE;
+        if (ctx->isFirstSCC){
+            scc->isLeaf = TRUE;
+            ctx->isFirstSCC = FALSE;
         }
-        else if (0 == SETDIFF(descendents,sccinfos[currentSCC].sccVertices)) {
-            sccinfos[currentSCC].isLeaf = TRUE;
+        else if (ISSUBSET(descendents,scc->sccVertices,m)) {
+            scc->isLeaf = TRUE;
         }      
             
         // done with recording this strongly connected component
-        currentSCC++;
+        ctx->currentSCC++;
+    }
+}
+
+/***************************/
+// REACHABILITY algorithm
+/*********************/
+
+// An alternative to tarjan for single-word graphs, using only word operations:
+// take the transitive closure of the rows, then the SCC of v is the set of
+// vertices that v reaches and that reach v back. An SCC is a leaf exactly
+// when it is everything its vertices can reach. Fills in ctx->sccinfos and
+// ctx->currentSCC the same way tarjan does, though in a different order.
+
+void reachscc(struct sccstate *ctx, graph * g, int n);
+
+void reachscc(struct sccstate *ctx, graph * g, int n)
+{
+    setword reach[MAXN];
+    setword left,scc,w;
+    int i,k,v;
+    
+    for (i=0; i<n; i++) reach[i] = g[i] | bit[i];
+    
+    // Warshall: after step k, reach[i] includes paths through 0..k.
+    // The row update is masked rather than branched on.
+    for (k=0; k<n; k++)
+        for (i=0; i<n; i++)
+            reach[i] |= reach[k] & -((reach[i] >> (WORDSIZE-1-k)) & 1);
+    
+    ctx->currentSCC = 0;
+    left = ALLMASK(n);
+    while (left)
+    {
+        v = FIRSTBITNZ(left);
+        scc = 0;
+        w = reach[v] & left;
+        while (w)
+        {
+            TAKEBIT(k,w);
+            if (reach[k] & bit[v]) scc |= bit[k];
+        }
+        ctx->sccinfos[ctx->currentSCC].sccVertices[0] = scc;
+        ctx->sccinfos[ctx->currentSCC].sccSize = POPCOUNT(scc);
+        ctx->sccinfos[ctx->currentSCC].isLeaf = (SETDIFF(reach[v],scc) == 0);
+        ctx->currentSCC++;
+        left &= ~scc;
+    }
+}
+
+/***************************/
+// SOURCES
+/*********************/
+
+// The source SCCs of g (those with no arcs in from other SCCs) are the leaf
+// SCCs of its converse, so --sources runs the same SCC code on the converse,
+// into a second sccstate. The colouring stage then tests each colouring
+// against both.
+
+static void
+findsources(graph *g, int m, int n)
+{
+    memcpy(arena.gconv, g, m * (size_t)n * sizeof(graph));
+    converse(arena.gconv,m,n);
+    if (rswitch && m == 1)
+        reachscc(&sourcescc, arena.gconv, n);
+    else
+        tarjan(&sourcescc, arena.gconv, m, n);
+}
+
+/***************************/
+// PROGRESS
+/*********************/
+
+// A progress line on stderr every progresssecs seconds (--progress), and
+// whenever SIGUSR1 comes. The same timer rewrites the --metrics-file. The
+// signal handlers only set progressdue and metricsdue, which colourinput
+// tests once per graph, so the clock isn't read per graph.
+
+#define PROGRESSSECS 5
+
+static volatile sig_atomic_t progressdue = 0;
+static volatile sig_atomic_t metricsdue = 0;
+
+static struct {
+    FILE *f;            // the input being read
+    char *name;
+    off_t size;         // or 0 if not a regular file
+    long long start;    // nanotime() when it was opened
+} progress;
+
+static void
+progresshandler(int sig)
+{
+    progressdue = 1;
+}
+
+static void
+alarmhandler(int sig)
+{
+    if (progresssecs > 0) progressdue = 1;
+    if (metricsname) metricsdue = 1;
+}
+
+static void
+startprogress(void)
+/* Catch SIGUSR1, and with --progress or --metrics-file set the interval
+   timer going. This is after dispatch_engine, as the timer would outlive
+   an exec and the handlers would not. */
+{
+    struct sigaction sa;
+    struct itimerval it;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = progresshandler;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR1,&sa,NULL);
+    if (progresssecs > 0 || metricsname)
+    {
+        sa.sa_handler = alarmhandler;
+        sigaction(SIGALRM,&sa,NULL);
+        it.it_interval.tv_sec = it.it_value.tv_sec =
+            progresssecs > 0 ? progresssecs : PROGRESSSECS;
+        it.it_interval.tv_usec = it.it_value.tv_usec = 0;
+        setitimer(ITIMER_REAL,&it,NULL);
+    }
+}
+
+static void
+progressinput(FILE *f, char *name)
+/* Note the start of a new input. */
+{
+    struct stat st;
+
+    progress.f = f;
+    progress.name = name;
+    progress.size = (fstat(fileno(f),&st) == 0 && S_ISREG(st.st_mode))
+                    ? st.st_size : 0;
+    progress.start = nanotime();
+}
+
+static double
+bigtodouble(struct bigcount *big)
+{
+    double x;
+    int i;
+
+    x = 0;
+    for (i = big->len-1; i >= 0; --i) x = x * BIGBASE + big->limb[i];
+    return x;
+}
+
+static void
+writeprogress(void)
+/* Write a progress line for the current input to stderr: graphs read,
+   bytes read, graphs and output digraphs per second, and the time left. */
+{
+    double secs,count;
+    off_t pos;
+
+    progressdue = 0;
+    secs = (nanotime() - progress.start) / 1e9;
+    count = bigtodouble(&bigTotal) + (double)totalCount;
+    pos = ftello(progress.f);
+
+    fprintf(stderr,">R %s: %lld graphs",progress.name,graphCount);
+    if (pos >= 0 && progress.size > 0)
+        fprintf(stderr,", %.1f of %.1f MB (%.1f%%)", pos/1e6, progress.size/1e6,
+                100.0 * pos / progress.size);
+    else if (pos >= 0)
+        fprintf(stderr,", %.1f MB",pos/1e6);
+    if (secs > 0)
+        fprintf(stderr,", %.0f graphs/s, %.0f out/s",graphCount/secs,count/secs);
+    if (pos > 0 && progress.size > 0)
+        fprintf(stderr,", ETA %.0f s",(progress.size - pos) * secs / pos);
+    fprintf(stderr,"\n");
+}
+
+/***************************/
+// METRICS
+/*********************/
+
+// With --metrics-file FILE, FILE is rewritten in the Prometheus text format
+// on every timer tick and at the end of each input, for a scraper to pick
+// up. It is written to FILE.tmp and renamed, so that a reader never sees
+// half a file. The counters run over the whole process, across inputs.
+
+static struct {
+    long long graphs;       // input graphs in the inputs finished
+    double outputs;         // digraphs counted in the inputs finished
+    double inbytes;         // digraph6 bytes read, in all inputs
+    double outbytes;        // digraph6 bytes written with -d
+} metrics;
+
+static long
+residentbytes(void)
+/* The resident set size, or 0 if it can't be found. */
+{
+    FILE *f;
+    long pages,resident;
+
+    if ((f = fopen("/proc/self/statm","r")) == NULL) return 0;
+    if (fscanf(f,"%ld %ld",&pages,&resident) != 2) resident = 0;
+    fclose(f);
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+static long
+peakresidentbytes(void)
+/* The largest resident set size so far, or 0 if it can't be found. */
+{
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_SELF,&ru) != 0) return 0;
+    return ru.ru_maxrss * 1024L;       // kilobytes on Linux
+}
+
+static void
+writemetrics(void)
+{
+    static char *tmpname = NULL;
+    FILE *f;
+    int st;
+
+    metricsdue = 0;
+    if (!tmpname)
+    {
+        tmpname = malloc(strlen(metricsname) + 5);
+        if (!tmpname) gt_abort(">E gsinks: malloc failed\n");
+        strcpy(tmpname,metricsname);
+        strcat(tmpname,".tmp");
+    }
+    if ((f = fopen(tmpname,"w")) == NULL)
+    {
+        fprintf(stderr,">E gsinks: can't write %s: %s\n",tmpname,strerror(errno));
+        return;
+    }
+
+    fprintf(f,"# HELP gsinks_input_graphs_total Input digraphs coloured.\n"
+              "# TYPE gsinks_input_graphs_total counter\n"
+              "gsinks_input_graphs_total %lld\n", metrics.graphs + graphCount);
+    fprintf(f,"# HELP gsinks_output_graphs_total Digraphs with one global sink counted.\n"
+              "# TYPE gsinks_output_graphs_total counter\n"
+              "gsinks_output_graphs_total %.17g\n",
+            metrics.outputs + bigtodouble(&bigTotal) + (double)totalCount);
+    fprintf(f,"# HELP gsinks_read_bytes_total Digraph6 bytes read.\n"
+              "# TYPE gsinks_read_bytes_total counter\n"
+              "gsinks_read_bytes_total %.17g\n", metrics.inbytes);
+    fprintf(f,"# HELP gsinks_written_bytes_total Digraph6 bytes written (-d).\n"
+              "# TYPE gsinks_written_bytes_total counter\n"
+              "gsinks_written_bytes_total %.17g\n", metrics.outbytes);
+    if (vswitch)
+    {
+        fprintf(f,"# HELP gsinks_stage_seconds_total Estimated time in each stage (-v).\n"
+                  "# TYPE gsinks_stage_seconds_total counter\n");
+        for (st = 0; st < NSTAGES; ++st)
+            fprintf(f,"gsinks_stage_seconds_total{stage=\"%s\"} %.6f\n",
+                    stagetimers[st].name,
+                    (stagetimers[st].donens + stagens(&stagetimers[st])) / 1e9);
+    }
+    fprintf(f,"# HELP gsinks_resident_memory_bytes Resident set size.\n"
+              "# TYPE gsinks_resident_memory_bytes gauge\n"
+              "gsinks_resident_memory_bytes %ld\n", residentbytes());
+    fprintf(f,"# HELP gsinks_peak_resident_memory_bytes Largest resident set size so far.\n"
+              "# TYPE gsinks_peak_resident_memory_bytes gauge\n"
+              "gsinks_peak_resident_memory_bytes %ld\n", peakresidentbytes());
+    fprintf(f,"# HELP gsinks_last_update_seconds Unix time of this update.\n"
+              "# TYPE gsinks_last_update_seconds gauge\n"
+              "gsinks_last_update_seconds %ld\n", (long)time(NULL));
+
+    if (fclose(f) != 0 || rename(tmpname,metricsname) != 0)
+        fprintf(stderr,">E gsinks: can't write %s: %s\n",metricsname,strerror(errno));
+}
+
+static long
+d6length(int n)
+/* The length of a digraph6 line for n vertices, with the newline. */
+{
+    long bits = (long)n * n;
+
+    return 1 + (n <= SMALLN ? 1 : n <= SMALLISHN ? 4 : 8) + (bits + 5) / 6 + 1;
+}
+
+/***************************/
+// PROFILING
+/*********************/
+
+// With --profile-graphs FILE, every input graph gets a CSV record in FILE:
+// its input, its ordinal there (from 1), n, the number of SCCs and of leaf
+// SCCs, the size of the group left once twins are ordered (0 if too big),
+// the digraphs it adds to the count,
+// and the nanoseconds spent colouring it (nauty and the colouring stage).
+// The PROFILETOP slowest graphs of each input are also listed on stderr.
+
+#define PROFILETOP 10
+
+struct profilerec {long long ordinal; int n; long long ns; count128 groupsize;};
+static struct profilerec slowest[PROFILETOP];   // slowest first
+static int nslowest;
+static char *profileinput;                      // the input being read
+
+static char *
+count128tostring(count128 x)
+{
+    static struct bigcount big;
+
+    big.len = 0;
+    bigadd(&big,x);
+    return bigtostring(&big);
+}
+
+static void
+colourinput(graph *g, int nsccs, int m, int n)
+/* Colour an input graph whose SCCs are known, profiling it if asked.
+   nsccs is its number of SCCs, as sccs may list only the leaves (-b). */
+{
+    long long t0,ns;
+    int i,leaves;
+
+    if (progressdue) writeprogress();
+    if (metricsdue) writemetrics();
+
+    t0 = profilefile ? nanotime() : 0;
+    colourdigraph(g,0,mine,maxe,2,m,n);
+    if (metricsname && dswitch)
+        metrics.outbytes += (double)(totalCount - graphStart) * d6length(n+1);
+    if (tracing && ++spangraphs == TRACEGRAPHS) tracespan();
+    if (!profilefile) return;
+    ns = nanotime() - t0;
+
+    leaves = 0;
+    for (i = 0; i < sccs->currentSCC; ++i) leaves += sccs->sccinfos[i].isLeaf;
+    fprintf(profilefile,"%s,%lld,%d,%d,%d,%s,",profileinput,graphCount,n,
+            nsccs,leaves,count128tostring(groupsize));
+    fprintf(profilefile,"%s,%lld\n",count128tostring(totalCount - graphStart),ns);
+
+    // keep the slowest graphs, by insertion
+    if (nslowest == PROFILETOP && ns <= slowest[PROFILETOP-1].ns) return;
+    if (nslowest < PROFILETOP) ++nslowest;
+    for (i = nslowest-1; i > 0 && slowest[i-1].ns < ns; --i)
+        slowest[i] = slowest[i-1];
+    slowest[i].ordinal = graphCount;
+    slowest[i].n = n;
+    slowest[i].ns = ns;
+    slowest[i].groupsize = groupsize;
+}
+
+static void
+writeslowest(void)
+/* List the slowest graphs of the input on stderr, and reset. */
+{
+    int i;
+
+    fprintf(stderr,">G slowest graphs in %s (ordinal, n, group size, us):\n",
+            profileinput);
+    for (i = 0; i < nslowest; ++i)
+        fprintf(stderr,">G %lld %d %s %.3f\n",slowest[i].ordinal,slowest[i].n,
+                count128tostring(slowest[i].groupsize),slowest[i].ns/1e3);
+    nslowest = 0;
+}
+
+/***************************/
+// INPUT
+/*********************/
+
+static graph *
+readdigraph(FILE *f, graph *g, int *pm, int *pn)
+/* Read the next graph from f into g, which has room for MAXN vertices.
+   Return NULL at the end of the file. */
+{
+    char *s;
+    int n;
+    long long t0;
+
+    TIMER_START(T_DECODE,t0);
+    if ((s = gtools_getline(f)) == NULL)
+    {
+        TIMER_STOP(T_DECODE,t0);
+        return NULL;
+    }
+    if (metricsname) metrics.inbytes += strlen(s);
+    n = graphsize(s);
+    if (n >= MAXN)
+    {
+        // too late to hand over to the wide engine, as the input is part read
+        fprintf(stderr,">E gsinks: input graph has %d vertices, this build "
+                       "takes at most %d\n", n, MAXN-1);
+#ifdef WIDE_ENGINE
+        fprintf(stderr,"   Use %s for this input.\n", WIDE_ENGINE);
+#endif
+        exit(1);
+    }
+    *pn = n;
+    *pm = SETWORDSNEEDED(n);
+    stringtograph(s,g,*pm);
+    TIMER_STOP(T_DECODE,t0);
+    return g;
+}
+
+/***************************/
+// BATCHED REACHABILITY
+/*********************/
+
+// For single-word builds, -b decodes SCCBATCH graphs at a time and finds the
+// leaf SCCs of all of them together. The closures are kept vertex-major with
+// one lane per graph, so every step of the loops below is the same word
+// operation across all lanes and can be done with SIMD instructions.
+// Only the leaf SCCs are handed to the colouring stage, as that is all
+// filter_and_output looks at.
+
+#if MAXM == 1
+
+#ifndef SCCBATCH
+#define SCCBATCH 32      // 8 and 16 also make sense
+#endif
+
+static struct {
+    graph g[SCCBATCH][MAXN];            // the graphs as read
+    setword reach[MAXN][SCCBATCH];      // closure rows, one lane per graph
+    setword leafvertices[SCCBATCH];     // union of the leaf SCCs of each graph
+    int n;
+} sccbatch;
+
+static void
+batchreach(int n)
+/* Find leafvertices for all SCCBATCH lanes. Lanes beyond the graphs
+   read are computed as well, but ignored. */
+{
+    int i,k,v,w,lane;
+    setword ok[SCCBATCH];
+
+    for (i = 0; i < n; ++i)
+        for (lane = 0; lane < SCCBATCH; ++lane)
+            sccbatch.reach[i][lane] = sccbatch.g[lane][i] | bit[i];
+
+    for (k = 0; k < n; ++k)
+        for (i = 0; i < n; ++i)
+            for (lane = 0; lane < SCCBATCH; ++lane)
+                sccbatch.reach[i][lane] |= sccbatch.reach[k][lane]
+                     & -((sccbatch.reach[i][lane] >> (WORDSIZE-1-k)) & 1);
+
+    // v is in a leaf SCC exactly when everything v reaches reaches v back
+    for (lane = 0; lane < SCCBATCH; ++lane) sccbatch.leafvertices[lane] = 0;
+    for (v = 0; v < n; ++v)
+    {
+        for (lane = 0; lane < SCCBATCH; ++lane) ok[lane] = ~(setword)0;
+        for (w = 0; w < n; ++w)
+            for (lane = 0; lane < SCCBATCH; ++lane)
+                ok[lane] &= ~(-((sccbatch.reach[v][lane] >> (WORDSIZE-1-w)) & 1))
+                          | -((sccbatch.reach[w][lane] >> (WORDSIZE-1-v)) & 1);
+        for (lane = 0; lane < SCCBATCH; ++lane)
+            sccbatch.leafvertices[lane] |= ok[lane] & bit[v];
+    }
+}
+
+static int
+batchsccs(int lane, int n)
+/* The number of SCCs of the graph in lane, for --profile-graphs, as
+   flushbatch only lists the leaves. Each pass peels off the SCC of the
+   first vertex left: what it reaches that reaches it back. */
+{
+    setword left,scc;
+    int v,w,count;
+
+    count = 0;
+    left = ALLMASK(n);
+    while (left)
+    {
+        v = FIRSTBITNZ(left);
+        scc = 0;
+        for (w = v; w < n; ++w)
+            if ((sccbatch.reach[v][lane] & bit[w])
+                    && (sccbatch.reach[w][lane] & bit[v]))
+                scc |= bit[w];
+        left &= ~scc;
+        ++count;
+    }
+    return count;
+}
+
+static void
+flushbatch(int count)
+/* Find the leaf SCCs of the first count graphs, then colour them. */
+{
+    int lane,v,n;
+    setword leaves;
+    long long t0;
+
+    if (count == 0) return;
+    n = sccbatch.n;
+    TIMER_START(T_SCC,t0);
+    batchreach(n);
+    TIMER_STOP(T_SCC,t0);
+    if (n != scankernel_n) selectkernels(n);
+
+    for (lane = 0; lane < count; ++lane)
+    {
+        // a leaf SCC is what any of its vertices reaches
+        sccs->currentSCC = 0;
+        leaves = sccbatch.leafvertices[lane];
+        while (leaves)
+        {
+            v = FIRSTBITNZ(leaves);
+            sccs->sccinfos[sccs->currentSCC].sccVertices[0] = sccbatch.reach[v][lane];
+            sccs->sccinfos[sccs->currentSCC].sccSize = POPCOUNT(sccbatch.reach[v][lane]);
+            sccs->sccinfos[sccs->currentSCC].isLeaf = TRUE;
+            sccs->currentSCC++;
+            leaves &= ~sccbatch.reach[v][lane];
+        }
+        if (sourceswitch)
+        {
+            TIMER_START(T_SCC,t0);
+            findsources(sccbatch.g[lane],1,n);
+            TIMER_STOP(T_SCC,t0);
+        }
+        colourinput(sccbatch.g[lane],profilefile ? batchsccs(lane,n) : 0,1,n);
+    }
+}
+
+static void
+colourbatched(FILE *infile)
+/* Read and colour all graphs in infile, SCCBATCH at a time.
+   A batch is cut short if n changes. */
+{
+    int m,n,count;
+    graph *g;
+
+    count = 0;
+    for (;;)
+    {
+        g = readdigraph(infile,sccbatch.g[count],&m,&n);
+        if (!g)
+        {
+            flushbatch(count);
+            return;
+        }
+        if (count > 0 && n != sccbatch.n)
+        {
+            flushbatch(count);
+            memcpy(sccbatch.g[0], sccbatch.g[count], n * sizeof(setword));
+            count = 0;
+        }
+        sccbatch.n = n;
+        if (++count == SCCBATCH)
+        {
+            flushbatch(count);
+            count = 0;
+        }
     }
 }
+
+#endif
             
 /**********************************************************************/
 /* Top-level function: read input arguments, open appropriate 
@@ -528,21 +2312,206 @@ void strongconnect(graph * g,int v,int n,int m)
 /**********************************************************************/
 
 #define INFILE_PREFIX "dig"
-#define INFILE_LOOP_MODIFIER 'l'
+#define INFILE_LOOP_MODIFIER "l"
 #define INFILE_SUFFIX ".d6"
+#define STDIN_NAME "-"
+
+// The output graphs have one more vertex than the input graphs, so this build
+// can handle N up to MAXN. For larger N, replace this process with the wide
+// engine, passing on the same arguments. The engine is looked for next to
+// this executable, found through /proc/self/exe as argv[0] may be a bare
+// name found on $PATH. Failing that, a directory in argv[0] is used, and
+// otherwise $PATH is searched.
+static void
+dispatch_engine(int argc, char *argv[], long countN)
+{
+#ifdef WIDE_ENGINE
+    char self[PATH_MAX];
+    char *enginepath;
+    char *dir;
+    char *slash;
+    size_t dirlen;
+    ssize_t len;
+#endif
+
+    if (countN <= MAXN) return;
+
+#ifdef WIDE_ENGINE
+    len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (len > 0)
+    {
+        self[len] = '\0';
+        dir = self;
+    }
+    else
+        dir = argv[0];
+    slash = strrchr(dir,'/');
+
+    if (slash)
+    {
+        dirlen = (size_t)(slash - dir) + 1;
+        enginepath = malloc(dirlen + sizeof(WIDE_ENGINE));
+        if (!enginepath) gt_abort(">E gsinks: malloc failed\n");
+        memcpy(enginepath, dir, dirlen);
+        strcpy(enginepath + dirlen, WIDE_ENGINE);
+        execv(enginepath, argv);
+    }
+    else
+    {
+        enginepath = WIDE_ENGINE;
+        execvp(enginepath, argv);
+    }
+    fprintf(stderr,">E gsinks: can't run %s for N=%ld: %s\n",
+            enginepath, countN, strerror(errno));
+#else
+    fprintf(stderr,">E gsinks: N=%ld exceeds MAXN=%d\n", countN, MAXN);
+#endif
+    exit(1);
+}
+
+static boolean
+parserange(char *s, long *pmin, long *pmax)
+/* Parse "min:max", "min:", ":max" or "k" (for k:k) into *pmin and *pmax.
+   Return FALSE if s isn't one of those. */
+{
+    char *endptr;
+
+    *pmin = 0;
+    *pmax = NOLIMIT;
+    if (*s != ':')
+    {
+        *pmin = strtol(s,&endptr,10);
+        if (endptr == s || *pmin < 0) return FALSE;
+        s = endptr;
+        if (*s == '\0')
+        {
+            *pmax = *pmin;
+            return TRUE;
+        }
+        if (*s != ':') return FALSE;
+    }
+    ++s;
+    if (*s != '\0')
+    {
+        *pmax = strtol(s,&endptr,10);
+        if (endptr == s || *endptr != '\0' || *pmax < *pmin) return FALSE;
+    }
+    return TRUE;
+}
+
+static int
+peekgraphsize(char *filename)
+/* The vertex count of the first graph in filename, or 0 if there is none. */
+{
+    FILE *f;
+    char *s;
+    int n;
+
+    if ((f = fopen(filename,"r")) == NULL) return 0;
+    s = gtools_getline(f);
+    n = s ? graphsize(s) : 0;
+    fclose(f);
+    return n;
+}
+
+static void
+colourfile(FILE *infile, char *name)
+/* Process each graph in infile, then report the total. */
+{
+    graph *g;
+    int m,n;
+    long long t0,tinput;
+
+    tinput = tracing ? nanotime() : 0;
+    profileinput = name;
+    progressinput(infile,name);
+#if MAXM == 1
+    if (bswitch)
+        colourbatched(infile);
+    else
+#endif
+    while (NULL != (g = readdigraph(infile,arena.g,&m,&n)))
+    {
+        if (n != scankernel_n) selectkernels(n);
+        TIMER_START(T_SCC,t0);
+        if (rswitch && m == 1)
+            reachscc(&sinkscc, g, n);
+        else
+            tarjan(&sinkscc, g, m, n);
+        if (sourceswitch) findsources(g, m, n);
+        TIMER_STOP(T_SCC,t0);
+        // Now color each graph, now that we know the SCCs 
+        colourinput(g,sccs->currentSCC,m,n);
+        // colourdigraph will call out to filter and count the graphs and output them if requested
+    }
+    if (tracing)
+    {
+        tracespan();
+        traceadd(strdup(name),tinput,nanotime() - tinput,0);
+    }
+    reducecount();
+    if (!qswitch){
+        fprintf(stderr,"%s\n",bigtostring(&bigTotal));
+    }
+    if (sourceswitch)
+    {
+        fprintf(stderr,">S %s\n",bigtostring(&bigSources));
+        bigSources.len = 0;
+    }
+    if (indegswitch) writeindegrees();
+    if (perfing) writeperf();
+    if (vswitch || perfing) writetimes(graphCount);
+    if (profilefile) writeslowest();
+#ifdef ALLOCCOUNT
+    fprintf(stderr,">A %lld heap allocations, %lld after the first graph\n",
+            allocations, graphCount > 1 ? allocations - allocmark : 0);
+#endif
+#ifdef PRUNECOUNT
+    fprintf(stderr,">C graphs=%lld: scanned=%lld gray=%lld sliced=%lld\n",
+            graphCount, prunecounts.scangraphs, prunecounts.graygraphs,
+            prunecounts.slicegraphs);
+    fprintf(stderr,">C scan nodes=%lld tries=%lld accepts=%lld leafrejects=%lld\n",
+            prunecounts.nodes, prunecounts.tries, prunecounts.accepts,
+            prunecounts.leafrejects);
+    fprintf(stderr,">C lastrejhits=%lld order2=%lld allgroups=%lld "
+            "elements/allgroup=%.2f\n",
+            prunecounts.lastrejhits, prunecounts.order2, prunecounts.allgroups,
+            prunecounts.allgroups > 0
+                ? (double)prunecounts.elements / prunecounts.allgroups : 0.0);
+    fprintf(stderr,">C gray colourings=%lld tries=%lld accepts=%lld leafrejects=%lld\n",
+            prunecounts.graysteps, prunecounts.graytries,
+            prunecounts.graytries, prunecounts.grayleafrejects);
+    fprintf(stderr,">C slice blocks=%lld tries=%lld accepts=%lld leafrejects=%lld\n",
+            prunecounts.sliceblocks, prunecounts.slicetries,
+            prunecounts.sliceaccepts, prunecounts.sliceleafrejects);
+    memset(&prunecounts, 0, sizeof(prunecounts));
+#endif
+    if (metricsname)
+    {
+        metrics.graphs += graphCount;
+        metrics.outputs += bigtodouble(&bigTotal);
+    }
+    bigTotal.len = 0;
+    graphCount = 0;
+    if (metricsname) writemetrics();
+}
 
+// bench.c includes this file with NOMAIN defined, to time the kernels.
+#ifndef NOMAIN
 int
 main(int argc, char *argv[])
 {
-    graph *g;
-    int m,n,codetype;
-    char infilename[10];    // dig[l][n].d6
+    int codetype;
+    char infilename[32];    // dig[l][n].d6
+    char **infiles;         // from -i
+    int ninfiles;
     FILE *infile;
-    int i,j;
+    int i,j,n,maxn;
     char *arg;
-    char * filepart;
+    char *val;
+    char *profilename;      // from --profile-graphs
     char * endptr;
-    boolean badargs,digraph;
+    boolean badargs;
     long countN = 0;
     int startN, endN;
 
@@ -554,8 +2523,24 @@ main(int argc, char *argv[])
     qswitch = FALSE;
     dswitch = FALSE;
     lswitch = FALSE;
-
-    infilename[0] = '\0';
+    rswitch = FALSE;
+    bswitch = FALSE;
+    sswitch = FALSE;
+    mine = 0;
+    maxe = NOLIMIT;
+    indegswitch = FALSE;
+    sourceswitch = FALSE;
+    vswitch = FALSE;
+    profilefile = NULL;
+    profilename = NULL;
+    progresssecs = 0;
+    metricsname = NULL;
+    tracename = NULL;
+    perfing = FALSE;
+
+    infiles = malloc(argc * sizeof(char*));
+    if (!infiles) gt_abort(">E gsinks: malloc failed\n");
+    ninfiles = 0;
     
     badargs = FALSE;
     for (j = 1; !badargs && j < argc; ++j)
@@ -567,6 +2552,44 @@ main(int argc, char *argv[])
                 case 'q': qswitch = TRUE; break;
                 case 'd': dswitch = TRUE; break;
                 case 'l': lswitch = TRUE; break;
+                case 'r': rswitch = TRUE; break;
+                case 'b': bswitch = TRUE; break;
+                case 's': sswitch = TRUE; break;
+                case 'v': vswitch = TRUE; break;
+                case 'e':
+                    val = (arg[2] != '\0') ? arg+2 : (j+1 < argc ? argv[++j] : NULL);
+                    if (!val || !parserange(val,&mine,&maxe)) badargs = TRUE;
+                    break;
+                case '-':
+                    if (strcmp(arg,"--by-indegree") == 0) indegswitch = TRUE;
+                    else if (strcmp(arg,"--sources") == 0) sourceswitch = TRUE;
+                    else if (strncmp(arg,"--profile-graphs=",17) == 0)
+                        profilename = arg+17;
+                    else if (strcmp(arg,"--profile-graphs") == 0 && j+1 < argc)
+                        profilename = argv[++j];
+                    else if (strncmp(arg,"--metrics-file=",15) == 0)
+                        metricsname = arg+15;
+                    else if (strcmp(arg,"--metrics-file") == 0 && j+1 < argc)
+                        metricsname = argv[++j];
+                    else if (strcmp(arg,"--perf") == 0) perfing = TRUE;
+                    else if (strncmp(arg,"--trace=",8) == 0)
+                        tracename = arg+8;
+                    else if (strcmp(arg,"--trace") == 0 && j+1 < argc)
+                        tracename = argv[++j];
+                    else if (strcmp(arg,"--progress") == 0)
+                        progresssecs = PROGRESSSECS;
+                    else if (strncmp(arg,"--progress=",11) == 0)
+                    {
+                        progresssecs = strtol(arg+11,&endptr,10);
+                        if (progresssecs <= 0 || *endptr != '\0') badargs = TRUE;
+                    }
+                    else badargs = TRUE;
+                    break;
+                case 'i':
+                    if (arg[2] != '\0') infiles[ninfiles++] = arg+2;
+                    else if (j+1 < argc) infiles[ninfiles++] = argv[++j];
+                    else badargs = TRUE;
+                    break;
                 default: badargs = TRUE;    
             }
         }
@@ -576,6 +2599,7 @@ main(int argc, char *argv[])
             if (countN <= 0){badargs = TRUE;}
         }
     }
+    if (ninfiles > 0 && countN > 0) badargs = TRUE;
 
     if (badargs)
     {
@@ -584,6 +2608,48 @@ main(int argc, char *argv[])
         exit(1);
     }
 
+    if (profilename)
+    {
+        if ((profilefile = fopen(profilename,"w")) == NULL)
+        {
+            fprintf(stderr,">E gsinks: can't open %s: %s\n",
+                    profilename, strerror(errno));
+            exit(1);
+        }
+        fprintf(profilefile,"input,ordinal,n,sccs,leaves,groupsize,accepted,ns\n");
+    }
+    tracing = (tracename != NULL);
+    if (perfing && !startperf()) exit(1);
+    timing = vswitch || tracing || perfing;
+
+    if (ninfiles > 0)
+    {
+        // hand over to the wide engine if any file starts with a big graph
+        maxn = 0;
+        for (i = 0; i < ninfiles; i++)
+            if (strcmp(infiles[i],STDIN_NAME) != 0
+                    && (n = peekgraphsize(infiles[i])) > maxn) maxn = n;
+        dispatch_engine(argc, argv, maxn+1);
+        startprogress();
+        if (tracing) starttrace();
+
+        for (i = 0; i < ninfiles; i++)
+        {
+            if (strcmp(infiles[i],STDIN_NAME) == 0)
+                infile = opengraphfile(NULL,&codetype,FALSE,1);
+            else
+                infile = opengraphfile(infiles[i],&codetype,FALSE,1);
+            if (!infile) exit(1);
+            colourfile(infile,infiles[i]);
+            if (infile != stdin) fclose(infile);
+        }
+        exit(0);
+    }
+
+    dispatch_engine(argc, argv, countN);
+    startprogress();
+    if (tracing) starttrace();
+
     if (countN == 1) 
     {
         // Need to write special code for this case 
@@ -603,30 +2669,15 @@ main(int argc, char *argv[])
     for (i = startN; i < endN; i++)
     {
         // contruct the input filename to be used
-        strcpy(infilename,INFILE_PREFIX);
-        filepart = infilename + strlen(INFILE_PREFIX);
-        if (lswitch){
-            *filepart++ = INFILE_LOOP_MODIFIER;
-        }
-        snprintf(filepart, filepart - infilename, "%d", i);
-        strcat(infilename, INFILE_SUFFIX);
+        snprintf(infilename, sizeof(infilename), "%s%s%d%s", INFILE_PREFIX,
+                 lswitch ? INFILE_LOOP_MODIFIER : "", i, INFILE_SUFFIX);
         
         // process each graph in each input file
         infile = opengraphfile(infilename,&codetype,FALSE,1);
         if (!infile) exit(1);
-        
-        while (NULL != (g = readgg_inc(infile,NULL,0,&m,&n,
-                            NULL,1,1,&digraph)))
-        {
-            tarjan(g, m, n);
-            // Now color each graph, now that we know the SCCs 
-            colourdigraph(g,0,0,NOLIMIT,2,m,n);
-            // colourdigraph will call out to filter and count the graphs and output them if requested
-        }
-        if (!qswitch){
-            fprintf(stderr,"%lld\n",totalCount);
-        }
-        totalCount = 0;
+        colourfile(infile,infilename);
+        fclose(infile);
     }
     exit(0);
 }
+#endif